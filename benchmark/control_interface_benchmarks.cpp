@@ -0,0 +1,373 @@
+#include <benchmark/benchmark.h>
+#include <control_interface/control_interface.h>
+#include <rcutils/logging.h>
+#include <cstdio>
+#include <random>
+
+// Benchmarks of the coordinate, yaw, mission-building and odometry hot paths.
+// Inputs are generated from a fixed seed, so every run measures the same data. Write the results as JSON with
+//   control_interface_benchmarks --benchmark_out=results.json --benchmark_out_format=json
+// or build the benchmark_json target. Build with -DCMAKE_BUILD_TYPE=Release, unoptimized numbers are meaningless.
+
+namespace control_interface
+{
+
+namespace
+{
+
+constexpr unsigned seed          = 42;
+constexpr double   ref_latitude  = 50.0755;  // [deg]
+constexpr double   ref_longitude = 14.4378;  // [deg]
+
+/* inputs //{ */
+std::vector<local_waypoint_t> randomLocalWaypoints(const size_t n) {
+  std::mt19937                           gen(seed);
+  std::uniform_real_distribution<double> xy(-2000.0, 2000.0);
+  std::uniform_real_distribution<double> z(1.0, 50.0);
+  std::uniform_real_distribution<double> yaw(-M_PI, M_PI);
+
+  std::vector<local_waypoint_t> wls(n);
+  for (auto &w : wls) {
+    w.x   = xy(gen);
+    w.y   = xy(gen);
+    w.z   = z(gen);
+    w.yaw = yaw(gen);
+  }
+  return wls;
+}
+
+// a planner path sampled every 10 cm, straight runs joined by gentle and sharp turns
+std::vector<local_waypoint_t> densePath(const size_t n) {
+  std::mt19937                           gen(seed);
+  std::uniform_real_distribution<double> turn(-0.05, 0.05);
+  std::uniform_real_distribution<double> corner(-M_PI / 2, M_PI / 2);
+
+  std::vector<local_waypoint_t> wls(n);
+  double                        heading = 0.0;
+  for (size_t i = 1; i < n; i++) {
+    heading += i % 200 == 0 ? corner(gen) : (i / 50) % 2 == 0 ? 0.0 : turn(gen);
+    wls[i].x   = wls[i - 1].x + 0.1 * std::cos(heading);
+    wls[i].y   = wls[i - 1].y + 0.1 * std::sin(heading);
+    wls[i].z   = 5.0;
+    wls[i].yaw = heading;
+  }
+  return wls;
+}
+
+std::vector<gps_waypoint_t> randomGpsWaypoints(const size_t n) {
+  std::mt19937                           gen(seed);
+  std::uniform_real_distribution<double> offset(-0.02, 0.02);  // [deg], roughly 2 km around the origin
+  std::uniform_real_distribution<double> altitude(1.0, 50.0);
+  std::uniform_real_distribution<double> yaw(-M_PI, M_PI);
+
+  std::vector<gps_waypoint_t> wgs(n);
+  for (auto &w : wgs) {
+    w.latitude  = ref_latitude + offset(gen);
+    w.longitude = ref_longitude + offset(gen);
+    w.altitude  = altitude(gen);
+    w.yaw       = yaw(gen);
+  }
+  return wgs;
+}
+
+std::vector<Eigen::Quaterniond> randomQuaternions(const size_t n) {
+  std::mt19937                           gen(seed);
+  std::uniform_real_distribution<double> angle(-M_PI, M_PI);
+
+  std::vector<Eigen::Quaterniond> qs(n);
+  for (auto &q : qs) {
+    q = Eigen::AngleAxisd(angle(gen), Eigen::Vector3d::UnitZ()) * Eigen::AngleAxisd(angle(gen) / 8, Eigen::Vector3d::UnitY()) *
+        Eigen::AngleAxisd(angle(gen) / 8, Eigen::Vector3d::UnitX());
+  }
+  return qs;
+}
+
+nav_msgs::msg::Path randomPath(const size_t n) {
+  const auto          qs = randomQuaternions(n);
+  nav_msgs::msg::Path path;
+  path.poses.resize(n);
+  for (size_t i = 0; i < n; i++) {
+    path.poses[i].pose.orientation.w = qs[i].w();
+    path.poses[i].pose.orientation.x = qs[i].x();
+    path.poses[i].pose.orientation.y = qs[i].y();
+    path.poses[i].pose.orientation.z = qs[i].z();
+  }
+  return path;
+}
+//}
+
+/* class MockPublisher //{ */
+// counts the messages instead of handing them to the middleware, so the benchmarks measure only the work of the node
+template <class T>
+class MockPublisher : public rclcpp::Publisher<T> {
+public:
+  MockPublisher(rclcpp::Node &node, const std::string &topic)
+      : rclcpp::Publisher<T>(node.get_node_base_interface().get(), topic, rclcpp::QoS(rclcpp::KeepLast(1)), rclcpp::PublisherOptions()) {
+  }
+
+  using rclcpp::Publisher<T>::publish;
+
+  void publish(const T &msg) override {
+    benchmark::DoNotOptimize(&msg);
+    published++;
+  }
+
+  uint64_t published = 0;
+};
+//}
+
+}  // namespace
+
+/* struct VehicleBenchmark //{ */
+// a vehicle without a MAVSDK connection, its publishers are replaced by mocks and its timers are never spun
+struct VehicleBenchmark
+{
+  std::shared_ptr<rclcpp::Node>  node;
+  mavsdk::Mavsdk                 mavsdk;
+  std::shared_ptr<CommandWorker> command_worker;
+  std::unique_ptr<Vehicle>       vehicle;
+
+  VehicleBenchmark() {
+    node = std::make_shared<rclcpp::Node>("control_interface_benchmark", rclcpp::NodeOptions().start_parameter_services(false));
+    // the per-waypoint INFO logs would flood the output, below the threshold they are not even formatted
+    rcutils_logging_set_logger_level(node->get_logger().get_name(), RCUTILS_LOG_SEVERITY_WARN);
+
+    command_worker = std::make_shared<CommandWorker>(node->get_logger(), 1.0, nullptr);
+    vehicle_params_t params;
+    params.waypoint_buffer_capacity = 32768;  // the largest path of BM_PublishDebugMarkers
+    vehicle = std::make_unique<Vehicle>(*node, mavsdk, command_worker, nullptr, nullptr, params, "benchmark", "uav1", 1, "~/");
+
+    vehicle->coord_transform_ = std::make_shared<GeodeticTransform>(ref_latitude, ref_longitude);
+    vehicle->sensors_.topics[sensor_stats_t::gps].received(std::chrono::steady_clock::now());
+
+    vehicle->tf_publisher_              = std::make_shared<MockPublisher<tf2_msgs::msg::TFMessage>>(*node, "~/tf_mock");
+    vehicle->local_odom_publisher_      = std::make_shared<MockPublisher<nav_msgs::msg::Odometry>>(*node, "~/local_odom_mock");
+    vehicle->desired_pose_publisher_    = std::make_shared<MockPublisher<geometry_msgs::msg::PoseStamped>>(*node, "~/desired_pose_mock");
+    vehicle->waypoint_marker_publisher_ = std::make_shared<MockPublisher<geometry_msgs::msg::PoseArray>>(*node, "~/waypoint_markers_mock");
+  }
+
+  // created by the first benchmark which needs it, destroyed by main before rclcpp shuts down
+  static std::unique_ptr<VehicleBenchmark> fixture;
+
+  static Vehicle &instance() {
+    if (fixture == nullptr) {
+      fixture = std::make_unique<VehicleBenchmark>();
+    }
+    return *fixture->vehicle;
+  }
+};
+
+std::unique_ptr<VehicleBenchmark> VehicleBenchmark::fixture;
+//}
+
+/* coordinate conversions //{ */
+static void BM_GlobalToLocal(benchmark::State &state) {
+  const auto transform = std::make_shared<GeodeticTransform>(ref_latitude, ref_longitude);
+  const auto wgs       = randomGpsWaypoints(state.range(0));
+  for (auto _ : state) {
+    auto wls = globalToLocal(transform, wgs);
+    benchmark::DoNotOptimize(wls.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_GlobalToLocal)->RangeMultiplier(8)->Range(8, 32768);
+
+static void BM_GlobalToLocalPointwise(benchmark::State &state) {
+  const auto transform = std::make_shared<GeodeticTransform>(ref_latitude, ref_longitude);
+  const auto wgs       = randomGpsWaypoints(state.range(0));
+  for (auto _ : state) {
+    for (const auto &w : wgs) {
+      auto wl = globalToLocal(transform, w);
+      benchmark::DoNotOptimize(wl);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_GlobalToLocalPointwise)->RangeMultiplier(8)->Range(8, 32768);
+
+static void BM_LocalToGlobal(benchmark::State &state) {
+  const auto transform = std::make_shared<GeodeticTransform>(ref_latitude, ref_longitude);
+  const auto wls       = randomLocalWaypoints(state.range(0));
+  for (auto _ : state) {
+    auto wgs = localToGlobal(transform, wls);
+    benchmark::DoNotOptimize(wgs.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_LocalToGlobal)->RangeMultiplier(8)->Range(8, 32768);
+
+static void BM_LocalToGlobalPointwise(benchmark::State &state) {
+  const auto transform = std::make_shared<GeodeticTransform>(ref_latitude, ref_longitude);
+  const auto wls       = randomLocalWaypoints(state.range(0));
+  for (auto _ : state) {
+    for (const auto &w : wls) {
+      auto wg = localToGlobal(transform, w);
+      benchmark::DoNotOptimize(wg);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_LocalToGlobalPointwise)->RangeMultiplier(8)->Range(8, 32768);
+//}
+
+/* getYaw //{ */
+static void BM_GetYawEigen(benchmark::State &state) {
+  const auto qs = randomQuaternions(1024);
+  for (auto _ : state) {
+    for (const auto &q : qs) {
+      benchmark::DoNotOptimize(getYaw(q));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * qs.size());
+}
+BENCHMARK(BM_GetYawEigen);
+
+static void BM_GetYawMsg(benchmark::State &state) {
+  const auto path = randomPath(1024);
+  for (auto _ : state) {
+    for (const auto &pose : path.poses) {
+      benchmark::DoNotOptimize(getYaw(pose.pose.orientation));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * path.poses.size());
+}
+BENCHMARK(BM_GetYawMsg);
+
+static void BM_GetYawFloat(benchmark::State &state) {
+  const auto         qs = randomQuaternions(1024);
+  std::vector<float> qf(4 * qs.size());
+  for (size_t i = 0; i < qs.size(); i++) {
+    qf[4 * i + 0] = qs[i].w();
+    qf[4 * i + 1] = qs[i].x();
+    qf[4 * i + 2] = qs[i].y();
+    qf[4 * i + 3] = qs[i].z();
+  }
+  for (auto _ : state) {
+    for (size_t i = 0; i < qs.size(); i++) {
+      benchmark::DoNotOptimize(getYaw(&qf[4 * i]));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * qs.size());
+}
+BENCHMARK(BM_GetYawFloat);
+
+static void BM_GetYawPath(benchmark::State &state) {
+  const auto path = randomPath(state.range(0));
+  for (auto _ : state) {
+    auto yaws = getYaw(path);
+    benchmark::DoNotOptimize(yaws.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_GetYawPath)->RangeMultiplier(8)->Range(8, 32768);
+//}
+
+/* addToMission //{ */
+static void BM_AddToMission(benchmark::State &state) {
+  auto      &vehicle = VehicleBenchmark::instance();
+  const auto wls     = randomLocalWaypoints(state.range(0));
+  for (auto _ : state) {
+    vehicle.mission_window_items_.clear();
+    for (size_t i = 0; i < wls.size(); i++) {
+      vehicle.addToMission(i > 0 ? wls[i - 1] : wls[i], wls[i], i + 1 < wls.size() ? &wls[i + 1] : nullptr);
+    }
+    benchmark::DoNotOptimize(vehicle.mission_window_items_.back());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_AddToMission)->RangeMultiplier(8)->Range(8, 32768);
+//}
+
+/* simplifyPath //{ */
+static void BM_SimplifyPath(benchmark::State &state) {
+  const auto dense   = densePath(state.range(0));
+  size_t     dropped = 0;
+  for (auto _ : state) {
+    auto wls = dense;
+    dropped  = simplifyPath(wls, 0.1, 0.1);
+    benchmark::DoNotOptimize(wls.data());
+  }
+  state.counters["dropped"] = dropped;
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SimplifyPath)->RangeMultiplier(8)->Range(8, 32768);
+//}
+
+/* flightRecorder //{ */
+// cost of one record on the flight path, the writer thread drains the queue every 10 ms
+static void BM_FlightRecorderRecord(benchmark::State &state) {
+  std::string error;
+  auto        recorder = FlightRecorder::create("/tmp/control_interface_benchmark.frec", 1 << 16, 8192, std::chrono::milliseconds(10), error);
+  if (recorder == nullptr) {
+    state.SkipWithError(error.c_str());
+    return;
+  }
+  // every run creates a new file, the mapping stays valid after it is removed
+  std::remove(recorder->path().c_str());
+  for (auto _ : state) {
+    recorder->record(flight_record_t::odometry, 1, 0, {1.0, 2.0, 3.0, 0.5});
+  }
+  state.counters["dropped"] = recorder->dropped();
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FlightRecorderRecord)->ThreadRange(1, 4);
+//}
+
+/* publishDebugMarkers //{ */
+static void BM_PublishDebugMarkers(benchmark::State &state) {
+  auto      &vehicle = VehicleBenchmark::instance();
+  const auto wls     = randomLocalWaypoints(state.range(0));
+  vehicle.waypoint_buffer_.append(wls.begin(), wls.end());
+  for (auto _ : state) {
+    vehicle.publishDebugMarkers();
+  }
+  vehicle.waypoint_buffer_.clear();
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PublishDebugMarkers)->RangeMultiplier(8)->Range(8, 32768);
+//}
+
+/* pixhawkOdomCallback //{ */
+static void BM_PixhawkOdomCallback(benchmark::State &state) {
+  auto &vehicle = VehicleBenchmark::instance();
+  vehicle.desired_pose_.store({1.0, 2.0, 3.0, 0.5});  // above the 0.5 m threshold, so the desired pose is published as well
+
+  std::mt19937                          gen(seed);
+  std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+  const auto                            qs = randomQuaternions(1024);
+  std::vector<px4_msgs::msg::VehicleOdometry> msgs(qs.size());
+  for (size_t i = 0; i < msgs.size(); i++) {
+    msgs[i].x    = position(gen);
+    msgs[i].y    = position(gen);
+    msgs[i].z    = position(gen);
+    msgs[i].q[0] = qs[i].w();
+    msgs[i].q[1] = qs[i].x();
+    msgs[i].q[2] = qs[i].y();
+    msgs[i].q[3] = qs[i].z();
+  }
+
+  size_t i = 0;
+  for (auto _ : state) {
+    // the subscription hands over an owned message, allocating it is part of the pipeline
+    vehicle.pixhawkOdomCallback(std::make_unique<px4_msgs::msg::VehicleOdometry>(msgs[i]));
+    i = (i + 1) % msgs.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PixhawkOdomCallback);
+//}
+
+}  // namespace control_interface
+
+int main(int argc, char **argv) {
+  rclcpp::init(argc, argv);
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    rclcpp::shutdown();
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  control_interface::VehicleBenchmark::fixture.reset();
+  rclcpp::shutdown();
+  return 0;
+}
@@ -0,0 +1,395 @@
+#include "px4_standin.h"
+#include <control_interface/control_interface.h>
+#include <rclcpp/executors/multi_threaded_executor.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// Runs a takeoff -> path -> land scenario of the control interface node against the in-process PX4 stand-in and reports the
+// waypoint-to-execution latency and the waypoint throughput of the node. Options are given as --name=value, see options_t.
+// The exit code is non-zero when the scenario does not complete or a waypoint is reached out of order, so it can gate CI.
+//   end_to_end_benchmark --waypoints=50 --ack_latency=0.02 --loss=0.05 --output=end_to_end.json
+
+namespace control_interface
+{
+
+namespace
+{
+
+/* struct options_t //{ */
+struct options_t
+{
+  int         waypoints           = 20;
+  double      spacing             = 5.0;   // [m] between neighbouring waypoints of the path
+  double      altitude            = 3.0;   // [m] of the path
+  double      takeoff_height      = 2.0;   // [m]
+  double      speed               = 5.0;   // [m/s] target velocity of the node
+  double      control_update_rate = 10.0;  // [Hz]
+  int         mission_window_size = 10;
+  double      ack_latency         = 0.0;  // [s]
+  double      ack_jitter          = 0.0;  // [s]
+  double      loss                = 0.0;
+  unsigned    seed                = 42;
+  int         port                = 14600;
+  double      timeout             = 120.0;  // [s] of each scenario step
+  std::string output;                       // file for the JSON report, which is printed in any case
+};
+
+bool parseOptions(int argc, char **argv, options_t &options) {
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    const size_t      eq  = arg.find('=');
+    if (arg.rfind("--", 0) != 0 || eq == std::string::npos) {
+      std::cerr << "Unknown argument '" << arg << "', expected --name=value" << std::endl;
+      return false;
+    }
+    const std::string name = arg.substr(2, eq - 2);
+    std::stringstream value(arg.substr(eq + 1));
+    if (name == "waypoints") {
+      value >> options.waypoints;
+    } else if (name == "spacing") {
+      value >> options.spacing;
+    } else if (name == "altitude") {
+      value >> options.altitude;
+    } else if (name == "takeoff_height") {
+      value >> options.takeoff_height;
+    } else if (name == "speed") {
+      value >> options.speed;
+    } else if (name == "control_update_rate") {
+      value >> options.control_update_rate;
+    } else if (name == "mission_window_size") {
+      value >> options.mission_window_size;
+    } else if (name == "ack_latency") {
+      value >> options.ack_latency;
+    } else if (name == "ack_jitter") {
+      value >> options.ack_jitter;
+    } else if (name == "loss") {
+      value >> options.loss;
+    } else if (name == "seed") {
+      value >> options.seed;
+    } else if (name == "port") {
+      value >> options.port;
+    } else if (name == "timeout") {
+      value >> options.timeout;
+    } else if (name == "output") {
+      value >> options.output;
+    } else {
+      std::cerr << "Unknown option '" << name << "'" << std::endl;
+      return false;
+    }
+    if (value.fail()) {
+      std::cerr << "Invalid value of option '" << name << "'" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+//}
+
+/* nodeOptions //{ */
+// the node reads its config from param_namespace, every parameter is given so that none of them falls back to its default
+rclcpp::NodeOptions nodeOptions(const options_t &options) {
+  const std::string ns = "param_namespace.";
+  return rclcpp::NodeOptions().parameter_overrides({
+      {ns + "device_url", "udp://:" + std::to_string(options.port)},
+      {ns + "system_id", 1},
+      {ns + "yaw_offset_correction", -1.5708},
+      {ns + "takeoff_height", options.takeoff_height},
+      {ns + "reset_octomap_before_takeoff", false},
+      {ns + "waypoint_marker_scale", 0.3},
+      {ns + "waypoint_loiter_time", 0.0},
+      {ns + "waypoint_acceptance_radius", 0.2},
+      {ns + "control_update_rate", options.control_update_rate},
+      {ns + "target_velocity", options.speed},
+      {ns + "command_timeout", 10.0},
+      {ns + "verify_local_odom_with_tf", false},
+      {ns + "mission_window_size", options.mission_window_size},
+      {ns + "mission_refill_threshold", options.mission_window_size / 3},
+      {ns + "waypoint_buffer_capacity", std::max(1000, options.waypoints)},
+      {ns + "stream_position_tolerance", 0.1},
+      {ns + "stream_yaw_tolerance", 0.05},
+      {ns + "max_acceleration", 2.0},
+      {ns + "max_acceptance_radius", 2.0},
+      {ns + "max_fly_through_turn", 2.356},
+      {ns + "simplify_tolerance_ratio", 0.0},  // every generated waypoint becomes a mission item
+      {ns + "simplify_yaw_tolerance", 0.1},
+      {ns + "offboard_control", false},
+      {ns + "offboard_setpoint_rate", 50.0},
+      {ns + "latency_export_period", 0.0},
+      {ns + "diagnostics_heartbeat_period", 1.0},
+      {ns + "flight_recorder_path", ""},
+      {ns + "flight_recorder_records", 1000000},
+      {ns + "flight_recorder_odometry_rate", 20.0},
+      {ns + "gps_timeout", 1.0},
+      {ns + "odometry_timeout", 0.5},
+      {ns + "control_mode_timeout", 2.0},
+      {ns + "land_detected_timeout", 2.0},
+      {ns + "qos.gps_in", "sensor_data"},
+      {ns + "qos.pixhawk_odom_in", "sensor_data"},
+      {ns + "qos.control_mode_in", "sensor_data"},
+      {ns + "qos.land_detected_in", "sensor_data"},
+      {ns + "qos.timesync_in", "sensor_data"},
+      {ns + "qos.mission_result_in", "reliable"},
+      {ns + "qos.waypoint_stream_in", "reliable"},
+      {ns + "qos.vehicle_command_out", "reliable"},
+      {ns + "qos.offboard_control_mode_out", "reliable"},
+      {ns + "qos.trajectory_setpoint_out", "reliable"},
+      {ns + "qos.local_odom_out", "reliable"},
+      {ns + "qos.desired_pose_out", "reliable"},
+      {ns + "qos.waypoint_markers_out", "reliable"},
+      {ns + "qos.diagnostics_out", "reliable"},
+      {ns + "qos.latency_out", "reliable"},
+  });
+}
+//}
+
+/* waitFor //{ */
+template <class Predicate>
+bool waitFor(const double timeout, Predicate predicate, const std::chrono::milliseconds period = std::chrono::milliseconds(5)) {
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeout));
+  while (std::chrono::steady_clock::now() < deadline) {
+    if (predicate()) {
+      return true;
+    }
+    std::this_thread::sleep_for(period);
+  }
+  return false;
+}
+//}
+
+/* call //{ */
+// the executor spins in another thread, the scenario only waits for the response
+template <class ServiceT>
+bool call(const typename rclcpp::Client<ServiceT>::SharedPtr &client, const std::shared_ptr<typename ServiceT::Request> &request, const double timeout) {
+  if (!client->wait_for_service(std::chrono::duration<double>(timeout))) {
+    return false;
+  }
+  auto future = client->async_send_request(request);
+  if (future.wait_for(std::chrono::duration<double>(timeout)) != std::future_status::ready) {
+    return false;
+  }
+  return future.get()->success;
+}
+//}
+
+/* struct percentiles_t //{ */
+struct percentiles_t
+{
+  double mean = 0.0;
+  double p50  = 0.0;
+  double p90  = 0.0;
+  double p99  = 0.0;
+  double max  = 0.0;
+};
+
+percentiles_t percentiles(std::vector<double> values) {
+  percentiles_t p;
+  if (values.empty()) {
+    return p;
+  }
+  std::sort(values.begin(), values.end());
+  auto at = [&values](const double q) { return values[std::min(values.size() - 1, size_t(q * values.size()))]; };
+  for (const double v : values) {
+    p.mean += v / values.size();
+  }
+  p.p50 = at(0.5);
+  p.p90 = at(0.9);
+  p.p99 = at(0.99);
+  p.max = values.back();
+  return p;
+}
+//}
+
+}  // namespace
+
+/* runScenario //{ */
+int runScenario(const options_t &options) {
+  auto log = rclcpp::get_logger("end_to_end_benchmark");
+
+  standin_params_t standin_params;
+  standin_params.mavsdk_port = options.port;
+  standin_params.ack_latency = options.ack_latency;
+  standin_params.ack_jitter  = options.ack_jitter;
+  standin_params.loss        = options.loss;
+  standin_params.seed        = options.seed;
+
+  // the node publishes and subscribes in ~/, i.e. /control_interface/
+  auto standin   = std::make_shared<Px4Standin>(standin_params);
+  auto telemetry = std::make_shared<TelemetryReplay>(standin, "/control_interface/", 100.0, 10.0);
+  auto node      = std::make_shared<ControlInterface>(nodeOptions(options));
+  auto client    = std::make_shared<rclcpp::Node>("end_to_end_benchmark_client");
+
+  auto arming_client  = client->create_client<std_srvs::srv::SetBool>("/control_interface/arming_in");
+  auto takeoff_client = client->create_client<std_srvs::srv::Trigger>("/control_interface/takeoff_in");
+  auto land_client    = client->create_client<std_srvs::srv::Trigger>("/control_interface/land_in");
+  auto path_client    = client->create_client<fog_msgs::srv::Path>("/control_interface/local_path_in");
+
+  rclcpp::executors::MultiThreadedExecutor executor(rclcpp::ExecutorOptions(), 4);
+  executor.add_node(node);
+  executor.add_node(telemetry);
+  executor.add_node(client);
+  std::thread spinner([&executor]() { executor.spin(); });
+
+  auto fail = [&](const std::string &step) {
+    RCLCPP_ERROR(log, "Scenario failed: %s", step.c_str());
+    executor.cancel();
+    spinner.join();
+    return 1;
+  };
+
+  /* arm and take off //{ */
+  // arming is rejected until the node has discovered the stand-in and received all sensors
+  auto arm_request  = std::make_shared<std_srvs::srv::SetBool::Request>();
+  arm_request->data = true;
+  if (!waitFor(
+          options.timeout, [&]() { return call<std_srvs::srv::SetBool>(arming_client, arm_request, 1.0); }, std::chrono::milliseconds(200))) {
+    return fail("arming");
+  }
+  if (!waitFor(options.timeout, [&]() { return standin->state().armed; })) {
+    return fail("vehicle did not arm");
+  }
+
+  const auto takeoff_start = std::chrono::steady_clock::now();
+  if (!call<std_srvs::srv::Trigger>(takeoff_client, std::make_shared<std_srvs::srv::Trigger::Request>(), options.timeout)) {
+    return fail("takeoff");
+  }
+  if (!waitFor(options.timeout, [&]() {
+        const auto s = standin->state();
+        return !s.landed && s.finished && std::abs(-s.position.z() - options.takeoff_height) < 0.3;
+      })) {
+    return fail("vehicle did not reach the takeoff height");
+  }
+  const double takeoff_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - takeoff_start).count();
+  //}
+
+  /* fly the path //{ */
+  // a lawnmower pattern, the node works in local ENU: x east, y north
+  auto path_request = std::make_shared<fog_msgs::srv::Path::Request>();
+  std::vector<Eigen::Vector3d> targets;  // NED, as reported by the stand-in
+  for (int i = 0; i < options.waypoints; i++) {
+    const int                       row = i / 5;
+    const int                       col = row % 2 == 0 ? i % 5 : 4 - i % 5;
+    geometry_msgs::msg::PoseStamped pose;
+    pose.pose.position.x    = col * options.spacing;
+    pose.pose.position.y    = (row + 1) * options.spacing;
+    pose.pose.position.z    = options.altitude;
+    pose.pose.orientation.w = 1.0;
+    path_request->path.poses.push_back(pose);
+    targets.emplace_back(pose.pose.position.y, pose.pose.position.x, -pose.pose.position.z);
+  }
+
+  const auto counters_before = standin->counters();
+  const auto path_start      = std::chrono::steady_clock::now();
+  if (!call<fog_msgs::srv::Path>(path_client, path_request, options.timeout)) {
+    return fail("path request");
+  }
+
+  // the waypoint i is executed once the stand-in flies towards it after reaching the waypoint i - 1
+  // reaching any later waypoint of the path first means that the node skipped some, the scenario fails right away
+  std::vector<double> latencies;
+  auto                released = path_start;
+  size_t              next     = 0;
+  size_t              seen     = 0;
+  size_t              skipped  = 0;
+  const bool          flown    = waitFor(options.timeout, [&]() {
+    const auto events = standin->events();
+    for (; seen < events.size() && next < targets.size() && skipped == 0; seen++) {
+      const auto &e = events[seen];
+      if (e.stamp < released) {
+        continue;
+      }
+      if ((e.target - targets[next]).norm() > 0.05) {
+        for (size_t i = next + 1; e.type == standin_event_t::type_t::item_reached && i < targets.size(); i++) {
+          if ((e.target - targets[i]).norm() <= 0.05) {
+            skipped = i;
+          }
+        }
+        continue;
+      }
+      if (e.type == standin_event_t::type_t::item_started && latencies.size() == next) {
+        latencies.push_back(std::chrono::duration<double>(e.stamp - released).count());
+      } else if (e.type == standin_event_t::type_t::item_reached && latencies.size() == next + 1) {
+        released = e.stamp;
+        next++;
+      }
+    }
+    return next == targets.size() || skipped != 0;
+  });
+  if (skipped != 0) {
+    return fail("waypoint " + std::to_string(skipped) + " reached before waypoint " + std::to_string(next));
+  }
+  if (!flown) {
+    return fail("path not completed, reached " + std::to_string(next) + " of " + std::to_string(targets.size()) + " waypoints");
+  }
+  const double path_time      = std::chrono::duration<double>(released - path_start).count();
+  const auto   counters_after = standin->counters();
+  //}
+
+  /* land //{ */
+  if (!call<std_srvs::srv::Trigger>(land_client, std::make_shared<std_srvs::srv::Trigger::Request>(), options.timeout)) {
+    return fail("landing");
+  }
+  if (!waitFor(options.timeout, [&]() {
+        const auto s = standin->state();
+        return s.landed && !s.armed;
+      })) {
+    return fail("vehicle did not land");
+  }
+  //}
+
+  executor.cancel();
+  spinner.join();
+
+  /* report //{ */
+  const auto        latency = percentiles(latencies);
+  std::stringstream json;
+  json << "{\n"
+       << "  \"waypoints\": " << options.waypoints << ",\n"
+       << "  \"ack_latency_s\": " << options.ack_latency << ",\n"
+       << "  \"ack_jitter_s\": " << options.ack_jitter << ",\n"
+       << "  \"loss\": " << options.loss << ",\n"
+       << "  \"seed\": " << options.seed << ",\n"
+       << "  \"control_update_rate_hz\": " << options.control_update_rate << ",\n"
+       << "  \"mission_window_size\": " << options.mission_window_size << ",\n"
+       << "  \"takeoff_time_s\": " << takeoff_time << ",\n"
+       << "  \"path_time_s\": " << path_time << ",\n"
+       << "  \"throughput_waypoints_per_s\": " << options.waypoints / path_time << ",\n"
+       << "  \"waypoint_to_execution_latency_s\": {\"mean\": " << latency.mean << ", \"p50\": " << latency.p50 << ", \"p90\": " << latency.p90
+       << ", \"p99\": " << latency.p99 << ", \"max\": " << latency.max << "},\n"
+       << "  \"path_mission_uploads\": " << counters_after.mission_uploads - counters_before.mission_uploads << ",\n"
+       << "  \"path_mission_items\": " << counters_after.mission_items - counters_before.mission_items << ",\n"
+       << "  \"path_commands\": " << counters_after.commands - counters_before.commands << ",\n"
+       << "  \"path_mavlink_received\": " << counters_after.received - counters_before.received << ",\n"
+       << "  \"path_mavlink_dropped\": "
+       << (counters_after.dropped_in + counters_after.dropped_out) - (counters_before.dropped_in + counters_before.dropped_out) << "\n"
+       << "}\n";
+
+  std::cout << json.str();
+  if (!options.output.empty()) {
+    std::ofstream(options.output) << json.str();
+  }
+  //}
+
+  return 0;
+}
+//}
+
+}  // namespace control_interface
+
+int main(int argc, char **argv) {
+  control_interface::options_t options;
+  if (!control_interface::parseOptions(argc, argv, options)) {
+    return 2;
+  }
+
+  // the node names the vehicle by the environment, like on the real drone
+  setenv("DRONE_DEVICE_ID", "uav1", 0);
+
+  rclcpp::init(0, nullptr);
+  const int result = control_interface::runScenario(options);
+  rclcpp::shutdown();
+  return result;
+}
@@ -0,0 +1,610 @@
+#include "px4_standin.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cstring>
+#include <stdexcept>
+
+namespace control_interface
+{
+
+namespace
+{
+
+constexpr uint8_t system_id    = 1;
+constexpr uint8_t component_id = MAV_COMP_ID_AUTOPILOT1;
+
+// PX4 custom modes, see px4_custom_mode.h
+constexpr uint8_t px4_main_mode_auto    = 4;
+constexpr uint8_t px4_sub_mode_takeoff  = 2;
+constexpr uint8_t px4_sub_mode_loiter   = 3;
+constexpr uint8_t px4_sub_mode_mission  = 4;
+constexpr uint8_t px4_sub_mode_land     = 6;
+constexpr float   force_disarm_magic    = 21196.0f;
+constexpr double  min_acceptance_radius = 0.1;  // [m]
+
+}  // namespace
+
+/* class Px4Standin //{ */
+
+/* constructor //{ */
+Px4Standin::Px4Standin(const standin_params_t &params)
+    : params_(params), home_(params.home_latitude, params.home_longitude), started_(std::chrono::steady_clock::now()), gen_(params.seed) {
+
+  socket_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+  if (socket_ < 0) {
+    throw std::runtime_error("Px4Standin: cannot create UDP socket");
+  }
+  sockaddr_in local{};
+  local.sin_family      = AF_INET;
+  local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  local.sin_port        = 0;
+  if (::bind(socket_, reinterpret_cast<sockaddr *>(&local), sizeof(local)) < 0) {
+    ::close(socket_);
+    throw std::runtime_error("Px4Standin: cannot bind UDP socket");
+  }
+
+  speed_  = params_.default_speed;
+  thread_ = std::thread(&Px4Standin::run, this);
+}
+//}
+
+/* destructor //{ */
+Px4Standin::~Px4Standin() {
+  stop_ = true;
+  thread_.join();
+  ::close(socket_);
+}
+//}
+
+/* state //{ */
+standin_state_t Px4Standin::state() {
+  std::scoped_lock lock(mutex_);
+  standin_state_t  s;
+  s.timestamp = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started_).count();
+  s.position  = position_;
+  s.yaw       = yaw_;
+  home_.globalFromLocal(position_.y(), position_.x(), s.latitude, s.longitude);
+  s.altitude       = params_.home_altitude - position_.z();
+  s.armed          = armed_;
+  s.landed         = landed_;
+  s.auto_mode      = true;  // only the auto modes are implemented
+  s.instance_count = instance_count_;
+  s.seq_current    = seq_current_;
+  s.seq_reached    = seq_reached_;
+  s.finished       = finished_;
+  return s;
+}
+//}
+
+/* events //{ */
+std::vector<standin_event_t> Px4Standin::events() {
+  std::scoped_lock lock(mutex_);
+  return events_;
+}
+//}
+
+/* counters //{ */
+standin_counters_t Px4Standin::counters() {
+  std::scoped_lock lock(mutex_);
+  return counters_;
+}
+//}
+
+/* run //{ */
+void Px4Standin::run() {
+  const auto step_period      = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / params_.sim_rate));
+  auto       next_step        = std::chrono::steady_clock::now();
+  auto       next_heartbeat   = next_step;
+  uint8_t    buffer[2048];
+  mavlink_message_t msg;
+  mavlink_status_t  status;
+
+  while (!stop_) {
+    pollfd fd{socket_, POLLIN, 0};
+    ::poll(&fd, 1, 1);
+
+    std::scoped_lock lock(mutex_);
+    if (fd.revents & POLLIN) {
+      const ssize_t n = ::recv(socket_, buffer, sizeof(buffer), 0);
+      for (ssize_t i = 0; i < n; i++) {
+        if (mavlink_parse_char(MAVLINK_COMM_0, buffer[i], &msg, &status)) {
+          handleMessage(msg);
+        }
+      }
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    while (now >= next_step) {
+      step(std::chrono::duration<double>(step_period).count());
+      next_step += step_period;
+    }
+    if (now >= next_heartbeat) {
+      sendHeartbeat();
+      next_heartbeat += std::chrono::seconds(1);
+    }
+    flushReplies(now);
+  }
+}
+//}
+
+/* step //{ */
+void Px4Standin::step(const double dt) {
+  switch (mode_) {
+    case mode_t::hold: {
+      break;
+    }
+
+    case mode_t::takeoff: {
+      if (moveTowards(Eigen::Vector3d(position_.x(), position_.y(), -takeoff_altitude_), params_.climb_speed, dt)) {
+        mode_ = mode_t::hold;
+      }
+      break;
+    }
+
+    case mode_t::mission: {
+      stepMission(dt);
+      break;
+    }
+
+    case mode_t::land: {
+      if (moveTowards(Eigen::Vector3d(position_.x(), position_.y(), 0.0), params_.climb_speed, dt)) {
+        // PX4 disarms automatically after touchdown
+        armed_ = false;
+        mode_  = mode_t::hold;
+      }
+      break;
+    }
+  }
+
+  landed_ = position_.z() > -0.05;
+}
+//}
+
+/* stepMission //{ */
+void Px4Standin::stepMission(const double dt) {
+  if (!armed_) {
+    return;
+  }
+
+  // DO items take effect immediately, navigation items take as long as flying to them
+  while (seq_current_ < static_cast<int>(mission_.size())) {
+    const mission_item_t &item = mission_[seq_current_];
+
+    if (item.command == MAV_CMD_DO_CHANGE_SPEED) {
+      if (std::isfinite(item.param2) && item.param2 > 0) {
+        speed_ = item.param2;
+      }
+      seq_current_++;
+      continue;
+    }
+
+    if (item.command != MAV_CMD_NAV_WAYPOINT && item.command != MAV_CMD_NAV_TAKEOFF) {
+      seq_current_++;
+      continue;
+    }
+
+    const Eigen::Vector3d target = targetOf(item);
+    if (!item_started_) {
+      item_started_ = true;
+      record(standin_event_t::type_t::item_started, target);
+    }
+    if (std::isfinite(item.param4)) {
+      yaw_ = item.param4 * M_PI / 180.0;
+    }
+
+    moveTowards(target, speed_, dt);
+    if ((target - position_).norm() <= std::max(double(item.param2), min_acceptance_radius)) {
+      seq_reached_  = seq_current_;
+      item_started_ = false;
+      record(standin_event_t::type_t::item_reached, target);
+      seq_current_++;
+      continue;
+    }
+    return;
+  }
+
+  if (!finished_ && mission_.size() > 0) {
+    finished_ = true;
+    mode_     = mode_t::hold;
+  }
+}
+//}
+
+/* moveTowards //{ */
+// returns true once the target is reached
+bool Px4Standin::moveTowards(const Eigen::Vector3d &target, const double speed, const double dt) {
+  const Eigen::Vector3d diff     = target - position_;
+  const double          distance = diff.norm();
+  const double          step     = speed * dt;
+  if (distance <= step) {
+    position_ = target;
+    return true;
+  }
+  position_ += diff * (step / distance);
+  return false;
+}
+//}
+
+/* record //{ */
+void Px4Standin::record(const standin_event_t::type_t type, const Eigen::Vector3d &target) {
+  events_.push_back({type, std::chrono::steady_clock::now(), seq_current_, target});
+}
+//}
+
+/* handleMessage //{ */
+void Px4Standin::handleMessage(const mavlink_message_t &msg) {
+  counters_.received++;
+
+  if (msg.msgid == MAVLINK_MSG_ID_HEARTBEAT) {
+    return;
+  }
+  if (std::bernoulli_distribution(params_.loss)(gen_)) {
+    counters_.dropped_in++;
+    return;
+  }
+
+  mavlink_message_t out;
+  switch (msg.msgid) {
+
+    case MAVLINK_MSG_ID_COMMAND_LONG: {
+      mavlink_command_long_t cmd;
+      mavlink_msg_command_long_decode(&msg, &cmd);
+      if (cmd.target_system != system_id) {
+        return;
+      }
+      counters_.commands++;
+      const float   params[7] = {cmd.param1, cmd.param2, cmd.param3, cmd.param4, cmd.param5, cmd.param6, cmd.param7};
+      const uint8_t result    = handleCommand(cmd.command, params);
+      mavlink_msg_command_ack_pack(system_id, component_id, &out, cmd.command, result, 0, 0, msg.sysid, msg.compid);
+      reply(out);
+      break;
+    }
+
+    case MAVLINK_MSG_ID_MISSION_COUNT: {
+      mavlink_mission_count_t count;
+      mavlink_msg_mission_count_decode(&msg, &count);
+      if (count.mission_type != MAV_MISSION_TYPE_MISSION) {
+        mavlink_msg_mission_ack_pack(system_id, component_id, &out, msg.sysid, msg.compid, MAV_MISSION_UNSUPPORTED, count.mission_type);
+        reply(out);
+        return;
+      }
+      upload_.clear();
+      upload_count_    = count.count;
+      upload_complete_ = count.count == 0;
+      if (upload_complete_) {
+        acceptMission();
+        mavlink_msg_mission_ack_pack(system_id, component_id, &out, msg.sysid, msg.compid, MAV_MISSION_ACCEPTED, MAV_MISSION_TYPE_MISSION);
+      } else {
+        mavlink_msg_mission_request_int_pack(system_id, component_id, &out, msg.sysid, msg.compid, 0, MAV_MISSION_TYPE_MISSION);
+      }
+      reply(out);
+      break;
+    }
+
+    case MAVLINK_MSG_ID_MISSION_ITEM_INT: {
+      mavlink_mission_item_int_t item;
+      mavlink_msg_mission_item_int_decode(&msg, &item);
+      counters_.mission_items++;
+
+      // the acknowledgement was lost and the node sent the last item again
+      if (upload_complete_) {
+        if (item.seq + 1 == upload_count_) {
+          mavlink_msg_mission_ack_pack(system_id, component_id, &out, msg.sysid, msg.compid, MAV_MISSION_ACCEPTED, MAV_MISSION_TYPE_MISSION);
+          reply(out);
+        }
+        return;
+      }
+
+      if (item.seq == upload_.size()) {
+        upload_.push_back({item.command, item.param1, item.param2, item.param3, item.param4, item.x, item.y, item.z});
+      }
+      if (upload_.size() == upload_count_) {
+        upload_complete_ = true;
+        acceptMission();
+        mavlink_msg_mission_ack_pack(system_id, component_id, &out, msg.sysid, msg.compid, MAV_MISSION_ACCEPTED, MAV_MISSION_TYPE_MISSION);
+      } else {
+        // a duplicate means our request was lost, ask for the expected item again
+        mavlink_msg_mission_request_int_pack(system_id, component_id, &out, msg.sysid, msg.compid, upload_.size(), MAV_MISSION_TYPE_MISSION);
+      }
+      reply(out);
+      break;
+    }
+
+    case MAVLINK_MSG_ID_MISSION_CLEAR_ALL: {
+      upload_.clear();
+      upload_count_    = 0;
+      upload_complete_ = true;
+      acceptMission();
+      mavlink_msg_mission_ack_pack(system_id, component_id, &out, msg.sysid, msg.compid, MAV_MISSION_ACCEPTED, MAV_MISSION_TYPE_MISSION);
+      reply(out);
+      break;
+    }
+
+    case MAVLINK_MSG_ID_MISSION_SET_CURRENT: {
+      mavlink_mission_set_current_t set_current;
+      mavlink_msg_mission_set_current_decode(&msg, &set_current);
+      if (set_current.seq < mission_.size()) {
+        seq_current_  = set_current.seq;
+        item_started_ = false;
+        finished_     = false;
+      }
+      mavlink_msg_mission_current_pack(system_id, component_id, &out, seq_current_);
+      reply(out);
+      break;
+    }
+
+    case MAVLINK_MSG_ID_PARAM_SET: {
+      mavlink_param_set_t param;
+      mavlink_msg_param_set_decode(&msg, &param);
+      char id[17] = {};
+      std::memcpy(id, param.param_id, 16);
+      if (std::strcmp(id, "MIS_TAKEOFF_ALT") == 0) {
+        takeoff_altitude_ = param.param_value;
+      }
+      // every parameter is accepted as it is
+      mavlink_msg_param_value_pack(system_id, component_id, &out, id, param.param_value, param.param_type, 1, 0);
+      reply(out);
+      break;
+    }
+
+    default: {
+      break;
+    }
+  }
+}
+//}
+
+/* handleCommand //{ */
+uint8_t Px4Standin::handleCommand(const uint16_t command, const float params[7]) {
+  switch (command) {
+
+    case MAV_CMD_COMPONENT_ARM_DISARM: {
+      if (params[0] > 0.5f) {
+        if (!landed_) {
+          return MAV_RESULT_DENIED;
+        }
+        armed_ = true;
+      } else {
+        if (!landed_ && params[1] != force_disarm_magic) {
+          return MAV_RESULT_DENIED;
+        }
+        armed_ = false;
+        mode_  = mode_t::hold;
+      }
+      return MAV_RESULT_ACCEPTED;
+    }
+
+    case MAV_CMD_NAV_TAKEOFF: {
+      if (!armed_) {
+        return MAV_RESULT_DENIED;
+      }
+      // MAVSDK sends NaN and sets MIS_TAKEOFF_ALT instead, otherwise param 7 is AMSL
+      if (std::isfinite(params[6])) {
+        takeoff_altitude_ = params[6] - params_.home_altitude;
+      }
+      mode_ = mode_t::takeoff;
+      return MAV_RESULT_ACCEPTED;
+    }
+
+    case MAV_CMD_NAV_LAND: {
+      if (!armed_) {
+        return MAV_RESULT_DENIED;
+      }
+      mode_ = mode_t::land;
+      return MAV_RESULT_ACCEPTED;
+    }
+
+    case MAV_CMD_DO_SET_MODE: {
+      const uint8_t main_mode = static_cast<uint8_t>(params[1]);
+      const uint8_t sub_mode  = static_cast<uint8_t>(params[2]);
+      if (main_mode != px4_main_mode_auto) {
+        return MAV_RESULT_UNSUPPORTED;
+      }
+      switch (sub_mode) {
+        case px4_sub_mode_mission: {
+          mode_         = mode_t::mission;
+          item_started_ = false;
+          return MAV_RESULT_ACCEPTED;
+        }
+        case px4_sub_mode_loiter: {
+          mode_ = mode_t::hold;
+          return MAV_RESULT_ACCEPTED;
+        }
+        case px4_sub_mode_takeoff: {
+          const float takeoff_params[7] = {0, 0, 0, 0, 0, 0, NAN};
+          return handleCommand(MAV_CMD_NAV_TAKEOFF, takeoff_params);
+        }
+        case px4_sub_mode_land: {
+          return handleCommand(MAV_CMD_NAV_LAND, params);
+        }
+        default: {
+          return MAV_RESULT_UNSUPPORTED;
+        }
+      }
+    }
+
+    default: {
+      // e.g. the autopilot capabilities requested by MAVSDK, it falls back to its defaults
+      return MAV_RESULT_UNSUPPORTED;
+    }
+  }
+}
+//}
+
+/* acceptMission //{ */
+// like PX4, a new mission restarts from its first item and gets a new instance count
+void Px4Standin::acceptMission() {
+  mission_ = upload_;
+  instance_count_++;
+  seq_current_  = 0;
+  seq_reached_  = -1;
+  finished_     = false;
+  item_started_ = false;
+  counters_.mission_uploads++;
+}
+//}
+
+/* reply //{ */
+void Px4Standin::reply(const mavlink_message_t &msg) {
+  if (std::bernoulli_distribution(params_.loss)(gen_)) {
+    counters_.dropped_out++;
+    return;
+  }
+
+  std::vector<uint8_t> bytes(MAVLINK_MAX_PACKET_LEN);
+  bytes.resize(mavlink_msg_to_send_buffer(bytes.data(), &msg));
+
+  const double delay = params_.ack_latency + std::uniform_real_distribution<double>(0.0, params_.ack_jitter)(gen_);
+  const auto   due   = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(delay));
+  pending_replies_.emplace(due, std::move(bytes));
+}
+//}
+
+/* sendHeartbeat //{ */
+void Px4Standin::sendHeartbeat() {
+  uint8_t sub_mode = px4_sub_mode_loiter;
+  switch (mode_) {
+    case mode_t::hold: {
+      sub_mode = px4_sub_mode_loiter;
+      break;
+    }
+    case mode_t::takeoff: {
+      sub_mode = px4_sub_mode_takeoff;
+      break;
+    }
+    case mode_t::mission: {
+      sub_mode = px4_sub_mode_mission;
+      break;
+    }
+    case mode_t::land: {
+      sub_mode = px4_sub_mode_land;
+      break;
+    }
+  }
+  const uint32_t custom_mode = (uint32_t(px4_main_mode_auto) << 16) | (uint32_t(sub_mode) << 24);
+  const uint8_t  base_mode   = MAV_MODE_FLAG_CUSTOM_MODE_ENABLED | (armed_ ? MAV_MODE_FLAG_SAFETY_ARMED : 0);
+
+  mavlink_message_t msg;
+  mavlink_msg_heartbeat_pack(system_id, component_id, &msg, MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_PX4, base_mode, custom_mode,
+                             armed_ ? MAV_STATE_ACTIVE : MAV_STATE_STANDBY);
+
+  // heartbeats bypass the emulated link, losing them would only make MAVSDK report the vehicle as disconnected
+  uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+  sendBytes(buffer, mavlink_msg_to_send_buffer(buffer, &msg));
+}
+//}
+
+/* flushReplies //{ */
+void Px4Standin::flushReplies(const std::chrono::steady_clock::time_point now) {
+  while (pending_replies_.size() > 0 && pending_replies_.begin()->first <= now) {
+    const auto &bytes = pending_replies_.begin()->second;
+    sendBytes(bytes.data(), bytes.size());
+    pending_replies_.erase(pending_replies_.begin());
+  }
+}
+//}
+
+/* sendBytes //{ */
+void Px4Standin::sendBytes(const uint8_t *data, const size_t length) {
+  sockaddr_in remote{};
+  remote.sin_family      = AF_INET;
+  remote.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  remote.sin_port        = htons(params_.mavsdk_port);
+  ::sendto(socket_, data, length, 0, reinterpret_cast<sockaddr *>(&remote), sizeof(remote));
+  counters_.sent++;
+}
+//}
+
+/* targetOf //{ */
+Eigen::Vector3d Px4Standin::targetOf(const mission_item_t &item) const {
+  double east, north;
+  home_.localFromGlobal(item.x * 1e-7, item.y * 1e-7, east, north);
+  return Eigen::Vector3d(north, east, -item.z);
+}
+//}
+
+//}
+
+/* class TelemetryReplay //{ */
+
+/* constructor //{ */
+TelemetryReplay::TelemetryReplay(std::shared_ptr<Px4Standin> standin, const std::string &topic_prefix, const double odometry_rate,
+                                 const double status_rate)
+    : Node("px4_telemetry_replay"), standin_(standin) {
+
+  // the same QoS as the microRTPS bridge
+  const rclcpp::QoS qos = rclcpp::SystemDefaultsQoS();
+  gps_publisher_            = create_publisher<px4_msgs::msg::VehicleGlobalPosition>(topic_prefix + "gps_in", qos);
+  odometry_publisher_       = create_publisher<px4_msgs::msg::VehicleOdometry>(topic_prefix + "pixhawk_odom_in", qos);
+  control_mode_publisher_   = create_publisher<px4_msgs::msg::VehicleControlMode>(topic_prefix + "control_mode_in", qos);
+  land_detected_publisher_  = create_publisher<px4_msgs::msg::VehicleLandDetected>(topic_prefix + "land_detected_in", qos);
+  mission_result_publisher_ = create_publisher<px4_msgs::msg::MissionResult>(topic_prefix + "mission_result_in", qos);
+  timesync_publisher_       = create_publisher<px4_msgs::msg::Timesync>(topic_prefix + "timesync_in", qos);
+
+  odometry_timer_ = create_wall_timer(std::chrono::duration<double>(1.0 / odometry_rate), std::bind(&TelemetryReplay::publishOdometry, this));
+  status_timer_   = create_wall_timer(std::chrono::duration<double>(1.0 / status_rate), std::bind(&TelemetryReplay::publishStatus, this));
+}
+//}
+
+/* publishOdometry //{ */
+void TelemetryReplay::publishOdometry() {
+  const auto state = standin_->state();
+
+  px4_msgs::msg::VehicleOdometry odom;
+  odom.timestamp = state.timestamp;
+  odom.x         = state.position.x();
+  odom.y         = state.position.y();
+  odom.z         = state.position.z();
+  odom.q[0]      = std::cos(state.yaw / 2);
+  odom.q[1]      = 0.0f;
+  odom.q[2]      = 0.0f;
+  odom.q[3]      = std::sin(state.yaw / 2);
+  odometry_publisher_->publish(odom);
+
+  px4_msgs::msg::VehicleGlobalPosition gps;
+  gps.timestamp = state.timestamp;
+  gps.lat       = state.latitude;
+  gps.lon       = state.longitude;
+  gps.alt       = state.altitude;
+  gps_publisher_->publish(gps);
+}
+//}
+
+/* publishStatus //{ */
+void TelemetryReplay::publishStatus() {
+  const auto state = standin_->state();
+
+  px4_msgs::msg::VehicleControlMode control_mode;
+  control_mode.timestamp                     = state.timestamp;
+  control_mode.flag_armed                    = state.armed;
+  control_mode.flag_control_auto_enabled     = state.auto_mode;
+  control_mode.flag_control_offboard_enabled = false;
+  control_mode_publisher_->publish(control_mode);
+
+  px4_msgs::msg::VehicleLandDetected land_detected;
+  land_detected.timestamp      = state.timestamp;
+  land_detected.landed         = state.landed;
+  land_detected.ground_contact = state.landed;
+  land_detected_publisher_->publish(land_detected);
+
+  px4_msgs::msg::MissionResult mission_result;
+  mission_result.timestamp      = state.timestamp;
+  mission_result.instance_count = state.instance_count;
+  mission_result.seq_current    = state.seq_current;
+  mission_result.seq_reached    = state.seq_reached;
+  mission_result.finished       = state.finished;
+  mission_result.valid          = true;
+  mission_result_publisher_->publish(mission_result);
+
+  px4_msgs::msg::Timesync timesync;
+  timesync.timestamp = state.timestamp;
+  timesync_publisher_->publish(timesync);
+}
+//}
+
+//}
+
+}  // namespace control_interface
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <common/mavlink.h>
+#include <control_interface/geodetic_transform.h>
+#include <eigen3/Eigen/Dense>
+#include <px4_msgs/msg/mission_result.hpp>
+#include <px4_msgs/msg/timesync.hpp>
+#include <px4_msgs/msg/vehicle_control_mode.hpp>
+#include <px4_msgs/msg/vehicle_global_position.hpp>
+#include <px4_msgs/msg/vehicle_land_detected.hpp>
+#include <px4_msgs/msg/vehicle_odometry.hpp>
+#include <rclcpp/rclcpp.hpp>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace control_interface
+{
+
+/* struct standin_params_t //{ */
+struct standin_params_t
+{
+  int      mavsdk_port    = 14600;    // UDP port of the MAVSDK connection under test, e.g. device_url "udp://:14600"
+  double   ack_latency    = 0.0;      // [s] delay of every reply to the node
+  double   ack_jitter     = 0.0;      // [s] uniformly distributed extra delay
+  double   loss           = 0.0;      // probability of dropping a message in each direction, heartbeats are never dropped
+  unsigned seed           = 42;       // the loss and jitter draws are reproducible
+  double   home_latitude  = 50.0755;  // [deg]
+  double   home_longitude = 14.4378;  // [deg]
+  double   home_altitude  = 300.0;    // [m] AMSL
+  double   default_speed  = 5.0;      // [m/s] until the mission changes it
+  double   climb_speed    = 2.0;      // [m/s] takeoff and landing
+  double   sim_rate       = 200.0;    // [Hz]
+};
+//}
+
+/* struct standin_state_t //{ */
+// vehicle state as the PX4 uORB topics would report it
+struct standin_state_t
+{
+  uint64_t        timestamp = 0;  // [us] since the stand-in started
+  Eigen::Vector3d position  = Eigen::Vector3d::Zero();  // NED, relative to home
+  double          yaw       = 0.0;                      // [rad] NED
+  double          latitude  = 0.0;
+  double          longitude = 0.0;
+  double          altitude  = 0.0;  // [m] AMSL
+  bool            armed     = false;
+  bool            landed    = true;
+  bool            auto_mode = false;
+
+  unsigned instance_count = 0;
+  int      seq_current    = 0;
+  int      seq_reached    = -1;
+  bool     finished       = false;
+};
+//}
+
+/* struct standin_event_t //{ */
+// progress of the vehicle through the uploaded mission, the position is the target of the item (NED)
+struct standin_event_t
+{
+  enum class type_t
+  {
+    item_started,  // the vehicle turned towards the item
+    item_reached
+  };
+
+  type_t                                type;
+  std::chrono::steady_clock::time_point stamp;
+  int                                   seq;
+  Eigen::Vector3d                       target;
+};
+//}
+
+/* struct standin_counters_t //{ */
+struct standin_counters_t
+{
+  uint64_t received        = 0;  // MAVLink messages from the node, including dropped ones
+  uint64_t sent            = 0;  // replies and heartbeats which reached the node
+  uint64_t dropped_in      = 0;
+  uint64_t dropped_out     = 0;
+  uint64_t commands        = 0;  // COMMAND_LONG, including retransmissions
+  uint64_t mission_uploads = 0;  // completed uploads
+  uint64_t mission_items   = 0;  // MISSION_ITEM_INT, including retransmissions
+};
+//}
+
+/* class Px4Standin //{ */
+// In-process stand-in for a PX4 autopilot. It answers the MAVLink mission, command and parameter protocols used by MAVSDK over UDP and
+// flies a kinematic point through the uploaded mission, without any physics. Replies can be delayed and lost to emulate a bad link.
+class Px4Standin {
+public:
+  explicit Px4Standin(const standin_params_t &params);
+  ~Px4Standin();
+
+  Px4Standin(const Px4Standin &) = delete;
+  Px4Standin &operator=(const Px4Standin &) = delete;
+
+  standin_state_t              state();
+  std::vector<standin_event_t> events();
+  standin_counters_t           counters();
+
+private:
+  enum class mode_t
+  {
+    hold,
+    takeoff,
+    mission,
+    land
+  };
+
+  struct mission_item_t
+  {
+    uint16_t command;
+    float    param1;
+    float    param2;
+    float    param3;
+    float    param4;
+    int32_t  x;  // [deg * 1e7]
+    int32_t  y;  // [deg * 1e7]
+    float    z;  // [m] relative to home
+  };
+
+  standin_params_t  params_;
+  GeodeticTransform home_;
+
+  int                                   socket_ = -1;
+  std::chrono::steady_clock::time_point started_;
+  std::atomic<bool>                     stop_ = false;
+  std::thread                           thread_;
+
+  // everything below is guarded by mutex_
+  std::mutex                                                        mutex_;
+  std::mt19937                                                      gen_;
+  std::multimap<std::chrono::steady_clock::time_point, std::vector<uint8_t>> pending_replies_;
+  standin_counters_t                                                counters_;
+  std::vector<standin_event_t>                                      events_;
+
+  mode_t          mode_             = mode_t::hold;
+  bool            armed_            = false;
+  bool            landed_           = true;
+  Eigen::Vector3d position_         = Eigen::Vector3d::Zero();
+  double          yaw_              = 0.0;
+  double          speed_            = 0.0;
+  float           takeoff_altitude_ = 2.5;
+
+  std::vector<mission_item_t> mission_;
+  std::vector<mission_item_t> upload_;
+  uint16_t                    upload_count_    = 0;
+  bool                        upload_complete_ = true;
+  unsigned                    instance_count_  = 0;
+  int                         seq_current_     = 0;
+  int                         seq_reached_     = -1;
+  bool                        finished_        = false;
+  bool                        item_started_    = false;
+
+  void run();
+  void step(const double dt);
+  void stepMission(const double dt);
+  bool moveTowards(const Eigen::Vector3d &target, const double speed, const double dt);
+  void record(const standin_event_t::type_t type, const Eigen::Vector3d &target);
+
+  void    handleMessage(const mavlink_message_t &msg);
+  uint8_t handleCommand(const uint16_t command, const float params[7]);
+  void    acceptMission();
+
+  void reply(const mavlink_message_t &msg);
+  void sendHeartbeat();
+  void flushReplies(const std::chrono::steady_clock::time_point now);
+  void sendBytes(const uint8_t *data, const size_t length);
+
+  Eigen::Vector3d targetOf(const mission_item_t &item) const;
+};
+//}
+
+/* class TelemetryReplay //{ */
+// publishes the state of the stand-in on the px4_msgs topics which the microRTPS bridge would provide
+class TelemetryReplay : public rclcpp::Node {
+public:
+  TelemetryReplay(std::shared_ptr<Px4Standin> standin, const std::string &topic_prefix, const double odometry_rate, const double status_rate);
+
+private:
+  std::shared_ptr<Px4Standin> standin_;
+
+  rclcpp::Publisher<px4_msgs::msg::VehicleGlobalPosition>::SharedPtr gps_publisher_;
+  rclcpp::Publisher<px4_msgs::msg::VehicleOdometry>::SharedPtr       odometry_publisher_;
+  rclcpp::Publisher<px4_msgs::msg::VehicleControlMode>::SharedPtr    control_mode_publisher_;
+  rclcpp::Publisher<px4_msgs::msg::VehicleLandDetected>::SharedPtr   land_detected_publisher_;
+  rclcpp::Publisher<px4_msgs::msg::MissionResult>::SharedPtr         mission_result_publisher_;
+  rclcpp::Publisher<px4_msgs::msg::Timesync>::SharedPtr              timesync_publisher_;
+
+  rclcpp::TimerBase::SharedPtr odometry_timer_;
+  rclcpp::TimerBase::SharedPtr status_timer_;
+
+  void publishOdometry();
+  void publishStatus();
+};
+//}
+
+}  // namespace control_interface
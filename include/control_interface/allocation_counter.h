@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+namespace control_interface
+{
+
+/* threadAllocations //{ */
+// Number of heap allocations made so far by the calling thread.
+// Counting is available only in builds with COUNT_ALLOCATIONS, where the control_interface_allocation_counter library replaces
+// the global operator new. It has to be preloaded (LD_PRELOAD) into the component container to see every allocation.
+// In regular builds this always returns zero.
+#ifdef CONTROL_INTERFACE_COUNT_ALLOCATIONS
+uint64_t threadAllocations();
+#else
+inline uint64_t threadAllocations() {
+  return 0;
+}
+#endif
+//}
+
+}  // namespace control_interface
@@ -0,0 +1,774 @@
+#pragma once
+
+#include <diagnostic_msgs/msg/diagnostic_array.hpp>
+#include <eigen3/Eigen/Dense>
+#include <fog_msgs/srv/waypoint_to_local.hpp>
+#include <fog_msgs/srv/path_to_local.hpp>
+#include <fog_msgs/srv/path.hpp>
+#include <fog_msgs/srv/vec4.hpp>
+#include <fog_msgs/msg/control_interface_diagnostics.hpp>
+#include <geometry_msgs/msg/transform_stamped.hpp>
+#include <geometry_msgs/msg/pose_array.hpp>
+#include <mavsdk/mavsdk.h>
+#include <mavsdk/plugins/action/action.h>
+#include <mavsdk/plugins/mission/mission.h>
+#include <nav_msgs/msg/odometry.hpp>
+#include <nav_msgs/msg/path.hpp>
+#include <px4_msgs/msg/mission_result.hpp>
+#include <px4_msgs/msg/offboard_control_mode.hpp>
+#include <px4_msgs/msg/timesync.hpp>
+#include <px4_msgs/msg/trajectory_setpoint.hpp>
+#include <px4_msgs/msg/vehicle_command.hpp>
+#include <px4_msgs/msg/vehicle_control_mode.hpp>
+#include <px4_msgs/msg/vehicle_global_position.hpp>
+#include <px4_msgs/msg/vehicle_land_detected.hpp>
+#include <px4_msgs/msg/vehicle_odometry.hpp>
+#include <rclcpp/rclcpp.hpp>
+#include <rclcpp/time.hpp>
+#include <std_msgs/msg/color_rgba.hpp>
+#include <std_msgs/msg/empty.hpp>
+#include <std_srvs/srv/set_bool.hpp>
+#include <std_srvs/srv/trigger.hpp>
+#include <std_srvs/srv/empty.hpp>
+#include <tf2_msgs/msg/tf_message.hpp>
+#include <tf2_ros/static_transform_broadcaster.h>
+#include <tf2_ros/transform_listener.h>
+#include <visualization_msgs/msg/marker_array.hpp>
+#include <control_interface/flight_recorder.h>
+#include <control_interface/geodetic_transform.h>
+#include <control_interface/latency_histogram.h>
+#include <control_interface/precondition_gate.h>
+#include <control_interface/ring_buffer.h>
+#include <control_interface/sensor_freshness.h>
+#include <control_interface/seqlock.h>
+#include <control_interface/spsc_queue.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+namespace control_interface
+{
+
+struct local_waypoint_t
+{
+  double x;
+  double y;
+  double z;
+  double yaw;
+};
+
+struct gps_waypoint_t
+{
+  double latitude;
+  double longitude;
+  double altitude;
+  double yaw;
+};
+
+/* struct segment_limits_t //{ */
+// limits of the vehicle used to plan the mission items of a path
+struct segment_limits_t
+{
+  double max_speed             = 1.0;    // [m/s] NAN leaves the speed to PX4
+  double max_acceleration      = 2.0;    // [m/s^2]
+  double min_acceptance_radius = 0.3;    // [m] at the waypoints where the vehicle stops
+  double max_acceptance_radius = 2.0;    // [m] at the waypoints it flies through at full speed
+  double max_fly_through_turn  = 2.356;  // [rad] sharper turns stop at the waypoint
+};
+
+// parameters of one mission item, the speed is used on the leg which follows the item
+struct segment_plan_t
+{
+  double speed;
+  double acceptance_radius;
+  bool   fly_through;
+};
+//}
+
+struct vehicle_odometry_t
+{
+  float pos[3];  // NED
+  float ori[4];  // w, x, y, z
+};
+
+struct global_position_t
+{
+  double latitude;
+  double longitude;
+  float  altitude;
+};
+
+/* struct latency_stats_t //{ */
+// timing of the hot paths of one vehicle, recorded without locks by any callback group and exported by the control loop
+struct latency_stats_t
+{
+  enum id_t
+  {
+    control_period,    // interval between two control loop ticks
+    control_routine,   // duration of one control loop tick
+    control_wakeup,    // from a new mission command to the control loop picking it up
+    offboard_period,   // interval between two offboard setpoint ticks
+    offboard_routine,  // duration of one offboard setpoint tick
+    odometry_callback,
+    tf_publish,
+    waypoint_stream_callback,
+    mission_upload,  // MAVSDK commands, from issuing the command to its acknowledgement
+    mission_start,
+    mission_pause,
+    mavsdk_arming,
+    mavsdk_takeoff,
+    mavsdk_land,
+    arming_service,  // services, including the wait for the MAVSDK acknowledgement
+    takeoff_service,
+    land_service,
+    local_waypoint_service,
+    local_path_service,
+    gps_waypoint_service,
+    gps_path_service,
+    waypoint_to_local_service,
+    path_to_local_service,
+    count
+  };
+
+  static constexpr std::array<const char *, count> names = {
+      "control_period", "control_routine", "control_wakeup", "offboard_period", "offboard_routine", "odometry_callback", "tf_publish", "waypoint_stream_callback",
+      "mission_upload", "mission_start", "mission_pause", "mavsdk_arming", "mavsdk_takeoff", "mavsdk_land",
+      "arming_service", "takeoff_service", "land_service", "local_waypoint_service", "local_path_service", "gps_waypoint_service", "gps_path_service",
+      "waypoint_to_local_service", "path_to_local_service"};
+
+  std::array<LatencyHistogram, count> histograms;
+  std::atomic<uint64_t>               control_overruns  = 0;  // control loop ticks which came later than 1.5 periods after the previous one
+  std::atomic<uint64_t>               offboard_overruns = 0;  // the same for the offboard setpoint ticks
+  std::atomic<uint64_t>               mission_uploads   = 0;
+  std::atomic<uint64_t>               mission_reuses    = 0;  // plans which were already on the vehicle and were not uploaded again
+  std::atomic<uint64_t>               path_points       = 0;  // waypoints of the paths and streamed routes before simplification
+  std::atomic<uint64_t>               path_dropped      = 0;  // waypoints removed by the simplification
+
+  void reset() {
+    for (auto &h : histograms) {
+      h.reset();
+    }
+    control_overruns  = 0;
+    offboard_overruns = 0;
+    mission_uploads   = 0;
+    mission_reuses    = 0;
+    path_points       = 0;
+    path_dropped      = 0;
+  }
+};
+//}
+
+/* struct sensor_stats_t //{ */
+// freshness of the PX4 telemetry topics, recorded by the telemetry callbacks and checked before the vehicle is commanded
+struct sensor_stats_t
+{
+  enum id_t
+  {
+    gps,
+    odometry,
+    control_mode,
+    land_detected,
+    count
+  };
+
+  static constexpr std::array<const char *, count> names = {"gps", "odometry", "control_mode", "land_detected"};
+
+  std::array<SensorFreshness, count> topics;
+};
+//}
+
+/* struct link_stats_t //{ */
+// MAVLink traffic between the node and one vehicle, counted by the MAVSDK threads which receive and send the messages
+struct link_stats_t
+{
+  std::atomic<uint64_t> received        = 0;  // messages from any component of the vehicle
+  std::atomic<uint64_t> sent            = 0;  // messages addressed to the vehicle, broadcasts are not counted
+  std::atomic<uint64_t> lost            = 0;  // gaps in the sequence numbers of the autopilot
+  std::atomic<uint64_t> command_retries = 0;  // COMMAND_LONG retransmissions by MAVSDK
+  std::atomic<uint64_t> mission_items   = 0;  // MISSION_ITEM_INT sent, including retransmissions
+  int                   last_seq        = -1;  // of the autopilot, used only by the receiving thread
+
+  void reset() {
+    received        = 0;
+    sent            = 0;
+    lost            = 0;
+    command_retries = 0;
+    mission_items   = 0;
+  }
+};
+//}
+
+/* helpers //{ */
+double getYaw(const Eigen::Quaterniond &q);
+double getYaw(const geometry_msgs::msg::Quaternion &q);
+double getYaw(const float q[4]);
+std::vector<double> getYaw(const nav_msgs::msg::Path &path);
+
+double radToDeg(const double &angle_rad);
+double degToRad(const double &angle_deg);
+
+std::pair<double, double>     globalToLocal(const std::shared_ptr<GeodeticTransform> &coord_transform, const double &latitude_deg, const double &longitude_deg);
+local_waypoint_t              globalToLocal(const std::shared_ptr<GeodeticTransform> &coord_transform, const gps_waypoint_t &wg);
+std::vector<local_waypoint_t> globalToLocal(const std::shared_ptr<GeodeticTransform> &coord_transform, const std::vector<gps_waypoint_t> &wgs);
+
+std::pair<double, double>   localToGlobal(const std::shared_ptr<GeodeticTransform> &coord_transform, const double &x, const double &y);
+gps_waypoint_t              localToGlobal(const std::shared_ptr<GeodeticTransform> &coord_transform, const local_waypoint_t &wl);
+std::vector<gps_waypoint_t> localToGlobal(const std::shared_ptr<GeodeticTransform> &coord_transform, const std::vector<local_waypoint_t> &wls);
+
+segment_plan_t                planSegment(const local_waypoint_t &previous, const local_waypoint_t &current, const local_waypoint_t *next,
+                                          const segment_limits_t &limits);
+size_t                        simplifyPath(std::vector<local_waypoint_t> &wls, const double position_tolerance, const double yaw_tolerance);
+size_t                        missionItemHash(const mavsdk::Mission::MissionItem &item);
+int                           mavlinkItemCount(const mavsdk::Mission::MissionItem &item);
+int                           missionItemReached(const std::vector<int> &first_seq, const int seq_reached);
+
+bool        isQosProfile(const std::string &profile);
+rclcpp::QoS qosProfile(const std::string &profile);
+//}
+
+
+/* class CommandWorker //{ */
+// Executes MAVSDK commands on a dedicated thread shared by all vehicles of the node. Waiting for MAVLink acknowledgements happens here, never on
+// the ROS executor. Commands of one vehicle run one by one in order, different vehicles wait for their acknowledgements concurrently
+class CommandWorker {
+public:
+  struct result_t
+  {
+    bool        success;
+    std::string message;
+  };
+
+  using DoneCallback = std::function<void(result_t)>;
+
+  // recorder may be null
+  CommandWorker(rclcpp::Logger logger, double timeout, std::shared_ptr<FlightRecorder> recorder);
+  ~CommandWorker();
+
+  // returns the lane used by all commands of one vehicle
+  size_t                addLane(const std::string &vehicle_name, const uint16_t system_id);
+  std::future<result_t> enqueue(const size_t lane, const std::string &name, const flight_record_t::command_t code,
+                                std::shared_ptr<LatencyHistogram> latency, std::function<void(DoneCallback)> execute);
+
+  template <class ResultT>
+  static result_t toResult(const ResultT result, const ResultT success);
+
+private:
+  struct command_t
+  {
+    std::string                       name;
+    flight_record_t::command_t        code;
+    std::function<void(DoneCallback)> execute;
+    std::promise<result_t>            promise;
+    std::shared_ptr<LatencyHistogram> latency;  // time from issuing the command to its outcome, may be null
+  };
+
+  struct lane_t
+  {
+    std::string                           vehicle_name;
+    uint16_t                              system_id;
+    std::deque<command_t>                 queue;
+    command_t                             current;
+    bool                                  in_flight  = false;
+    uint64_t                              generation = 0;  // acknowledgements of commands which already timed out are ignored
+    std::optional<result_t>               ack;
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::time_point deadline;
+  };
+
+  rclcpp::Logger                  logger_;
+  std::chrono::duration<double>   timeout_;
+  std::shared_ptr<FlightRecorder> recorder_;
+
+  std::deque<lane_t>      lanes_;  // never shrinks, references stay valid
+  std::mutex              mutex_;
+  std::condition_variable cv_;
+  bool                    stop_ = false;
+  std::thread             thread_;
+
+  void run();
+  void finish(lane_t &lane, const result_t &result);
+};
+//}
+
+/* class CommandChannel //{ */
+// MAVSDK commands of one vehicle, executed in order on its lane of the shared command worker
+// queued commands keep the plugins alive, so the channel may be destroyed before the worker
+class CommandChannel {
+public:
+  using result_t = CommandWorker::result_t;
+
+  // starts setting the takeoff altitude of the vehicle
+  CommandChannel(std::shared_ptr<CommandWorker> worker, std::shared_ptr<mavsdk::System> system, const std::string &vehicle_name,
+                 std::shared_ptr<latency_stats_t> latency, const float takeoff_altitude);
+
+  std::future<result_t> arm();
+  std::future<result_t> disarm();
+  // waits on the calling thread until the takeoff altitude is set
+  std::future<result_t> takeoff();
+  std::future<result_t> land();
+  std::future<result_t> uploadMission(const mavsdk::Mission::MissionPlan &mission_plan);
+  std::future<result_t> startMission();
+  std::future<result_t> pauseMission();
+  std::future<result_t> setCurrentMissionItem(int index);
+
+private:
+  using DoneCallback = CommandWorker::DoneCallback;
+
+  std::shared_ptr<CommandWorker>   worker_;
+  size_t                           lane_;
+  std::shared_ptr<mavsdk::Action>  action_;
+  std::shared_ptr<mavsdk::Mission> mission_;
+  std::shared_ptr<latency_stats_t> latency_;
+
+  // MAVSDK sets parameters only synchronously, the takeoff altitude is set once on a thread of its own instead of blocking the worker
+  float                        takeoff_altitude_;
+  std::shared_future<result_t> takeoff_altitude_set_;  // used only by the thread calling takeoff() after the constructor
+
+  void setTakeoffAltitude();
+
+  // shares the ownership of the whole latency_stats_t, queued commands may outlive the vehicle
+  std::shared_ptr<LatencyHistogram> histogram(const latency_stats_t::id_t id);
+};
+//}
+
+/* struct mission_command_t //{ */
+// request passed from the service callbacks to the control loop, which owns the waypoint buffer and the mission
+struct mission_command_t
+{
+  enum class type_t
+  {
+    append,
+    splice,  // waypoints replace the remaining route from the first point where they differ
+    stop
+  };
+
+  type_t                        type = type_t::append;
+  std::vector<local_waypoint_t> waypoints;
+
+  // stop only: fulfilled by the control loop with the pending result of pausing the vehicle
+  std::shared_ptr<std::promise<std::future<CommandChannel::result_t>>> stopped;
+};
+//}
+
+/* enum link_state_t //{ */
+enum class link_state_t
+{
+  no_connection,       // MAVSDK connection not open yet, retried by the node
+  waiting_for_system,  // connection open, the target system has not sent a heartbeat yet
+  connected,           // target system discovered and sending heartbeats
+  lost                 // target system stopped sending heartbeats
+};
+//}
+
+/* struct vehicle_params_t //{ */
+// config params shared by all vehicles of the node
+struct vehicle_params_t
+{
+  double yaw_offset_correction        = M_PI / 2;
+  double takeoff_height               = 2.5;
+  double waypoint_marker_scale        = 0.3;
+  double control_update_rate          = 10.0;
+  double waypoint_loiter_time         = 0.0;
+  bool   reset_octomap_before_takeoff = true;
+  double waypoint_acceptance_radius   = 0.3;
+  double target_velocity              = 1.0;
+  double command_timeout              = 10.0;
+  bool   verify_local_odom_with_tf    = false;
+  int    mission_window_size          = 10;
+  int    mission_refill_threshold     = 3;
+  double stream_position_tolerance    = 0.1;
+  double stream_yaw_tolerance         = 0.05;
+  bool   offboard_control             = false;
+  double offboard_setpoint_rate       = 50.0;
+  double latency_export_period        = 1.0;
+  double gps_timeout                  = 1.0;  // [s] a topic is stale if its last message is older
+  double odometry_timeout             = 0.5;
+  double control_mode_timeout         = 2.0;
+  double land_detected_timeout        = 2.0;
+  int    waypoint_buffer_capacity     = 1000;
+  double max_acceleration             = 2.0;    // [m/s^2] used to plan the speed and acceptance radius of each mission item
+  double max_acceptance_radius        = 2.0;    // [m] waypoint_acceptance_radius is the minimum
+  double max_fly_through_turn         = 2.356;  // [rad]
+  double simplify_tolerance_ratio     = 0.5;    // path simplification tolerance relative to waypoint_acceptance_radius, 0 keeps all waypoints
+  double simplify_yaw_tolerance       = 0.1;    // [rad]
+  double diagnostics_heartbeat_period = 1.0;    // [s] diagnostics are published on change, and at least this often
+  std::string flight_recorder_path          = "";       // empty disables the flight recorder, the start time is added to the file name
+  int         flight_recorder_records       = 1000000;  // [-] 64 bytes each, the file wraps around when full
+  double      flight_recorder_odometry_rate = 20.0;     // [Hz] 0 records every odometry message
+
+  // QoS profile of each topic, "sensor_data" (best effort, keep last 5) or "reliable" (keep last 3), both work with intra-process communication
+  std::map<std::string, std::string> qos = {
+      {"gps_in",                    "sensor_data"},
+      {"pixhawk_odom_in",           "sensor_data"},
+      {"control_mode_in",           "sensor_data"},
+      {"land_detected_in",          "sensor_data"},
+      {"timesync_in",               "sensor_data"},
+      {"mission_result_in",         "reliable"},
+      {"waypoint_stream_in",        "reliable"},
+      {"vehicle_command_out",       "reliable"},
+      {"offboard_control_mode_out", "reliable"},
+      {"trajectory_setpoint_out",   "reliable"},
+      {"local_odom_out",            "reliable"},
+      {"desired_pose_out",          "reliable"},
+      {"waypoint_markers_out",      "reliable"},
+      {"diagnostics_out",           "reliable"},
+      {"latency_out",               "reliable"},
+  };
+};
+//}
+
+/* class Vehicle //{ */
+// state, topics and services of one vehicle, owned by the ControlInterface node
+// topics and services are created on the node under topic_prefix, e.g. "~/" or "~/uav1/"
+class Vehicle {
+public:
+  Vehicle(rclcpp::Node &node, mavsdk::Mavsdk &mavsdk, std::shared_ptr<CommandWorker> command_worker, std::shared_ptr<tf2_ros::Buffer> tf_buffer,
+          std::shared_ptr<FlightRecorder> recorder, const vehicle_params_t &params, const std::string &name, const std::string &uav_name,
+          const int system_id, const std::string &topic_prefix);
+  ~Vehicle();
+
+  Vehicle(const Vehicle &) = delete;
+  Vehicle &operator=(const Vehicle &) = delete;
+
+  // called by the node once the shared MAVSDK connection is open
+  void connectionOpened();
+  // called from the MAVSDK thread whenever any new system appears on the shared connection
+  void newSystemDiscovered();
+  // called from the MAVSDK threads for every MAVLink message on the shared connection
+  void messageReceived(const uint8_t system_id, const uint8_t component_id, const uint8_t seq);
+  void messageSent(const int target_system, const uint32_t message_id, const bool retransmission);
+
+private:
+  friend struct VehicleBenchmark;  // benchmark/control_interface_benchmarks.cpp drives the private hot paths
+
+  bool              is_initialized_    = false;
+  std::atomic<bool> start_mission_     = false;
+  std::atomic<bool> armed_             = false;
+  std::atomic<bool> takeoff_requested_ = false;
+  std::atomic<bool> motion_started_    = false;
+  std::atomic<bool> landed_            = true;
+
+  std::atomic<bool>     offboard_enabled_ = false;  // PX4 reports that it follows the offboard setpoints
+  std::atomic<uint64_t> px4_timestamp_    = 0;      // [us] PX4 time from the timesync topic
+
+  std::atomic<bool> mission_finished_          = true;
+  unsigned          last_mission_instance_     = 1;
+  unsigned          mission_result_instance_   = 0;   // instance_count of the latest MissionResult
+  unsigned          replaced_mission_instance_ = 0;   // instance_count which was active when the current plan was uploaded
+  int               mission_seq_reached_       = -1;  // index of the last item of the current plan reached by the vehicle, not a MAVLink seq
+  int               mission_window_offset_     = 0;   // number of reached items already removed from the mission window
+
+  int64_t last_waypoint_stream_stamp_ = 0;  // [ns] stamp of the last accepted waypoint stream message, used only by the command group
+
+  // the services wake the control loop through an intra-process topic instead of waiting for the next tick of control_timer_
+  std::atomic<bool>    wakeup_pending_   = false;  // a wakeup message is on its way, set by the producer and cleared by the control loop
+  std::atomic<int64_t> wakeup_requested_ = 0;      // [steady clock ticks]
+
+  // readiness checked by the services, mirrored from the flags above by their writers
+  PreconditionGate          gate_;
+  PreconditionGate::guard_t arming_guard_;
+  PreconditionGate::guard_t takeoff_guard_;
+  PreconditionGate::guard_t land_guard_;
+  PreconditionGate::guard_t local_waypoint_guard_;
+  PreconditionGate::guard_t local_path_guard_;
+  PreconditionGate::guard_t gps_waypoint_guard_;
+  PreconditionGate::guard_t gps_path_guard_;
+  PreconditionGate::guard_t waypoint_to_local_guard_;
+  PreconditionGate::guard_t path_to_local_guard_;
+
+  // shared with the queued MAVSDK commands, which record their latency after the acknowledgement
+  std::shared_ptr<latency_stats_t>      latency_ = std::make_shared<latency_stats_t>();
+
+  link_stats_t                          link_;
+  uint64_t                              link_rate_received_ = 0;  // counts at the previous latency export, used to compute the message rates
+  uint64_t                              link_rate_sent_     = 0;
+  std::chrono::steady_clock::time_point link_rate_stamp_;
+
+  // last published diagnostics, a message goes out only when they change or the heartbeat period passes
+  uint32_t                              diagnostics_flags_    = 0;
+  size_t                                diagnostics_buffered_ = 0;
+  std::chrono::steady_clock::time_point diagnostics_stamp_;
+
+  // written by the telemetry callbacks, the control loop clears the sensors condition of gate_ once a topic goes stale
+  sensor_stats_t sensors_;
+  bool           sensors_fresh_ = false;  // last state seen by the control loop
+  std::chrono::steady_clock::time_point last_control_tick_;   // used only by the control loop
+  std::chrono::steady_clock::time_point last_offboard_tick_;  // used only by the offboard setpoint loop
+
+  // offboard setpoint in the PX4 local NED frame, owned by the control group
+  bool            offboard_setpoint_valid_ = false;
+  Eigen::Vector3d offboard_position_;
+  double          offboard_yaw_            = 0.0;
+  unsigned        offboard_setpoints_sent_ = 0;  // setpoints streamed since the setpoint was last reset
+
+  std::string uav_name_         = "";
+  std::string world_frame_      = "";
+  std::string ned_origin_frame_ = "";
+  std::string ned_fcu_frame_    = "";
+  std::string fcu_frame_        = "";
+
+  rclcpp::Node &node_;
+  std::string   name_;          // used in log messages
+  std::string   topic_prefix_;  // prepended to all topic and service names
+
+  int                             system_id_ = 1;
+  mavsdk::Mavsdk &                mavsdk_;  // shared by all vehicles of the node
+  std::shared_ptr<mavsdk::System> system_;
+  std::shared_ptr<CommandWorker>  command_worker_;  // shared by all vehicles of the node
+  std::shared_ptr<CommandChannel> commands_;        // written once by the control loop, published to the services by the connected condition of gate_
+
+  // link_state_ is written by the control loop and by MAVSDK callbacks, the rest only by the control loop
+  std::atomic<link_state_t> link_state_            = link_state_t::no_connection;
+  std::atomic<bool>         new_system_discovered_ = false;
+  link_state_t              last_link_state_       = link_state_t::no_connection;
+  mavsdk::Mission::MissionPlan mission_plan_;
+
+  // service callbacks are the only producer, the control loop is the only consumer and owns the buffer and mission state
+  SpscQueue<mission_command_t> mission_commands_{64};
+  RingBuffer<local_waypoint_t> waypoint_buffer_;
+  std::deque<local_waypoint_t> mission_window_;  // waypoints uploaded in the current mission plan, not reached yet
+
+  // free room of waypoint_buffer_ minus the waypoints queued in mission_commands_, taken by the services and returned by the control loop
+  std::atomic<int64_t>  buffer_credit_     = 0;
+  std::atomic<size_t>   buffer_high_water_ = 0;
+  std::atomic<uint64_t> buffer_rejections_ = 0;  // waypoints refused by the services or dropped from the waypoint stream
+
+  // mission items of mission_window_ with their hashes, converted once when the waypoint enters the window
+  struct planned_item_t
+  {
+    mavsdk::Mission::MissionItem item;
+    size_t                       hash;
+    local_waypoint_t             previous;  // the item is planned again once the waypoint after it changes
+  };
+  std::deque<planned_item_t>      mission_window_items_;
+  std::optional<local_waypoint_t> last_window_waypoint_;  // the last waypoint which left the window, where the vehicle comes from
+
+  // item hashes of the plan last uploaded to the vehicle, empty if it is unknown or has been finished
+  std::vector<size_t>                          vehicle_plan_;
+  std::vector<int>                             vehicle_plan_seq_;  // MAVLink seq of the first MAVLink item of each item of the last uploaded plan
+  std::shared_future<CommandChannel::result_t> vehicle_plan_upload_;
+  SeqLock<local_waypoint_t>    desired_pose_;
+
+  std::shared_ptr<tf2_ros::Buffer>                     tf_buffer_;  // shared by all vehicles, null unless verify_local_odom_with_tf_ is set
+  std::shared_ptr<FlightRecorder>                      recorder_;   // shared by all vehicles, null unless the flight recorder is enabled
+  std::chrono::steady_clock::duration                  odometry_record_period_{0};
+  std::chrono::steady_clock::time_point                last_odometry_record_;  // used only by the telemetry group
+  std::shared_ptr<tf2_ros::StaticTransformBroadcaster> static_tf_broadcaster_;
+
+  // preinitialized messages of the odometry hot path, the frame ids are set once in the constructor
+  // used only by pixhawkOdomCallback, so publishing them does not allocate
+  tf2_msgs::msg::TFMessage        tf_msg_;
+  nav_msgs::msg::Odometry         local_odom_msg_;
+  geometry_msgs::msg::PoseStamped desired_pose_msg_;
+
+  // rotations of the static transforms, used to compute the local odometry without a tf2 lookup
+  Eigen::Quaterniond ned_origin_in_world_;  // world -> ned_origin
+  Eigen::Quaterniond fcu_in_ned_fcu_;       // ned_fcu -> fcu
+
+  // last published local odometry, compared with the tf2 buffer in verification mode
+  rclcpp::Time       last_local_odom_stamp_;
+  Eigen::Vector3d    last_local_odom_position_;
+  Eigen::Quaterniond last_local_odom_orientation_;
+
+  // vehicle global position, written only by gpsCallback
+  SeqLock<global_position_t> global_position_;
+
+  // vehicle local position, written only by pixhawkOdomCallback
+  SeqLock<vehicle_odometry_t> odometry_;
+
+  // use takeoff lat and long to initialize local frame
+  // written once before the first gps message is recorded, read only after gettingPixhawkSensors() or the sensors condition of gate_ succeeds
+  std::shared_ptr<GeodeticTransform> coord_transform_;
+
+  // config params
+  double yaw_offset_correction_        = M_PI / 2;
+  double takeoff_height_               = 2.5;
+  double waypoint_marker_scale_        = 0.3;
+  double control_update_rate_          = 10.0;
+  double waypoint_loiter_time_         = 0.0;
+  bool   reset_octomap_before_takeoff_ = true;
+  double waypoint_acceptance_radius_   = 0.3;
+  double target_velocity_              = 1.0;
+  double command_timeout_              = 10.0;
+  bool   verify_local_odom_with_tf_    = false;
+  int    mission_window_size_          = 10;
+  int    mission_refill_threshold_     = 3;
+  double stream_position_tolerance_    = 0.1;
+  double stream_yaw_tolerance_         = 0.05;
+  bool   offboard_control_             = false;
+  double offboard_setpoint_rate_       = 50.0;
+  double latency_export_period_        = 1.0;
+  int    waypoint_buffer_capacity_     = 1000;
+  double simplify_position_tolerance_  = 0.1;
+  double simplify_yaw_tolerance_       = 0.1;
+  double diagnostics_heartbeat_period_ = 1.0;
+
+  segment_limits_t segment_limits_;
+
+  // publishers
+  rclcpp::Publisher<px4_msgs::msg::VehicleCommand>::SharedPtr   vehicle_command_publisher_;
+  rclcpp::Publisher<tf2_msgs::msg::TFMessage>::SharedPtr        tf_publisher_;
+  rclcpp::Publisher<nav_msgs::msg::Odometry>::SharedPtr         local_odom_publisher_;
+  rclcpp::Publisher<geometry_msgs::msg::PoseStamped>::SharedPtr desired_pose_publisher_;  // https://ctu-mrs.github.io/docs/system/relative_commands.html
+  rclcpp::Publisher<geometry_msgs::msg::PoseArray>::SharedPtr   waypoint_marker_publisher_;
+  rclcpp::Publisher<fog_msgs::msg::ControlInterfaceDiagnostics>::SharedPtr diagnostics_publisher_;
+  rclcpp::Publisher<px4_msgs::msg::OffboardControlMode>::SharedPtr          offboard_control_mode_publisher_;
+  rclcpp::Publisher<px4_msgs::msg::TrajectorySetpoint>::SharedPtr           trajectory_setpoint_publisher_;
+  rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr       latency_publisher_;
+  rclcpp::Publisher<std_msgs::msg::Empty>::SharedPtr                        wakeup_publisher_;
+
+  // subscribers
+  rclcpp::Subscription<px4_msgs::msg::VehicleGlobalPosition>::SharedPtr gps_subscriber_;
+  rclcpp::Subscription<px4_msgs::msg::VehicleOdometry>::SharedPtr       pixhawk_odom_subscriber_;
+  rclcpp::Subscription<px4_msgs::msg::VehicleControlMode>::SharedPtr    control_mode_subscriber_;
+  rclcpp::Subscription<px4_msgs::msg::VehicleLandDetected>::SharedPtr   land_detected_subscriber_;
+  rclcpp::Subscription<px4_msgs::msg::MissionResult>::SharedPtr         mission_result_subscriber_;
+  rclcpp::Subscription<nav_msgs::msg::Path>::SharedPtr                  waypoint_stream_subscriber_;
+  rclcpp::Subscription<px4_msgs::msg::Timesync>::SharedPtr              timesync_subscriber_;
+  rclcpp::Subscription<std_msgs::msg::Empty>::SharedPtr                 wakeup_subscriber_;
+
+  // subscriber callbacks
+  void gpsCallback(const px4_msgs::msg::VehicleGlobalPosition::UniquePtr msg);
+  void pixhawkOdomCallback(const px4_msgs::msg::VehicleOdometry::UniquePtr msg);
+  void controlModeCallback(const px4_msgs::msg::VehicleControlMode::UniquePtr msg);
+  void landDetectedCallback(const px4_msgs::msg::VehicleLandDetected::UniquePtr msg);
+  void missionResultCallback(const px4_msgs::msg::MissionResult::UniquePtr msg);
+  void waypointStreamCallback(const nav_msgs::msg::Path::UniquePtr msg);
+  void timesyncCallback(const px4_msgs::msg::Timesync::UniquePtr msg);
+  void wakeupCallback(const std_msgs::msg::Empty::UniquePtr msg);
+
+  // services provided
+  rclcpp::Service<std_srvs::srv::SetBool>::SharedPtr         arming_service_;
+  rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr         takeoff_service_;
+  rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr         land_service_;
+  rclcpp::Service<fog_msgs::srv::Vec4>::SharedPtr            local_waypoint_service_;
+  rclcpp::Service<fog_msgs::srv::Path>::SharedPtr            local_path_service_;
+  rclcpp::Service<fog_msgs::srv::Vec4>::SharedPtr            gps_waypoint_service_;
+  rclcpp::Service<fog_msgs::srv::Path>::SharedPtr            gps_path_service_;
+  rclcpp::Service<fog_msgs::srv::WaypointToLocal>::SharedPtr waypoint_to_local_service_;
+  rclcpp::Service<fog_msgs::srv::PathToLocal>::SharedPtr     path_to_local_service_;
+  rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr         latency_dump_service_;
+  rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr         latency_reset_service_;
+
+  rclcpp::Client<std_srvs::srv::Empty>::SharedPtr octomap_reset_client_;
+
+  // service callbacks
+  bool armingCallback(const std::shared_ptr<std_srvs::srv::SetBool::Request> request, std::shared_ptr<std_srvs::srv::SetBool::Response> response);
+  bool takeoffCallback(const std::shared_ptr<std_srvs::srv::Trigger::Request> request, std::shared_ptr<std_srvs::srv::Trigger::Response> response);
+  bool landCallback(const std::shared_ptr<std_srvs::srv::Trigger::Request> request, std::shared_ptr<std_srvs::srv::Trigger::Response> response);
+  bool localWaypointCallback(const std::shared_ptr<fog_msgs::srv::Vec4::Request> request, std::shared_ptr<fog_msgs::srv::Vec4::Response> response);
+  bool localPathCallback(const std::shared_ptr<fog_msgs::srv::Path::Request> request, std::shared_ptr<fog_msgs::srv::Path::Response> response);
+  bool gpsWaypointCallback(const std::shared_ptr<fog_msgs::srv::Vec4::Request> request, std::shared_ptr<fog_msgs::srv::Vec4::Response> response);
+  bool gpsPathCallback(const std::shared_ptr<fog_msgs::srv::Path::Request> request, std::shared_ptr<fog_msgs::srv::Path::Response> response);
+  bool waypointToLocalCallback(const std::shared_ptr<fog_msgs::srv::WaypointToLocal::Request> request,
+                               std::shared_ptr<fog_msgs::srv::WaypointToLocal::Response>      response);
+  bool pathToLocalCallback(const std::shared_ptr<fog_msgs::srv::PathToLocal::Request> request, std::shared_ptr<fog_msgs::srv::PathToLocal::Response> response);
+  bool latencyDumpCallback(const std::shared_ptr<std_srvs::srv::Trigger::Request> request, std::shared_ptr<std_srvs::srv::Trigger::Response> response);
+  bool latencyResetCallback(const std::shared_ptr<std_srvs::srv::Trigger::Request> request, std::shared_ptr<std_srvs::srv::Trigger::Response> response);
+
+  template <class ResponseT>
+  bool admit(const PreconditionGate::guard_t &guard, ResponseT &response);
+
+  bool gettingPixhawkSensors();
+  void sensorReceived(const sensor_stats_t::id_t id);
+  void updateSensorFreshness();
+  bool vehicleConnected();
+  void updateLink();
+  void printSensorsStatus();
+  void publishDiagnostics();
+
+  bool takeoff();
+  bool land();
+  void startMission();
+  void uploadMission();
+  void executeMission();
+  int  vehiclePlanOffset();
+
+  template <class ResponseT>
+  bool   fitsBuffer(const size_t count, const std::string &action, ResponseT &response);
+  size_t reserveBuffer(const size_t count, const bool partial);
+  void   releaseBuffer(const size_t count);
+  void   recordBufferSize();
+  void wakeControlLoop();
+  bool stopPreviousMission();
+  void simplify(std::vector<local_waypoint_t> &waypoints);
+  bool addWaypoints(std::vector<local_waypoint_t> &&waypoints);
+
+  void                                  processMissionCommands();
+  void                                  spliceWaypoints(const std::vector<local_waypoint_t> &route);
+  std::future<CommandChannel::result_t> stopMission();
+
+  void addToMission(const local_waypoint_t &previous, const local_waypoint_t &w, const local_waypoint_t *next);
+  void fillMissionWindow();
+  void updateMissionWindow();
+  bool missionWindowNeedsRefill();
+  void publishTF(const vehicle_odometry_t &odom, const rclcpp::Time &stamp);
+  void publishStaticTF();
+  void publishLocalOdom(const vehicle_odometry_t &odom, const rclcpp::Time &stamp);
+  void verifyLocalOdom(const Eigen::Vector3d &position, const Eigen::Quaterniond &orientation, const rclcpp::Time &stamp);
+  void publishDebugMarkers();
+  void publishDesiredPose(const rclcpp::Time &stamp);
+  void publishOffboardSetpoint();
+  void requestOffboardMode();
+
+  void        recordTick(std::chrono::steady_clock::time_point &last_tick, const double rate, const latency_stats_t::id_t period,
+                         std::atomic<uint64_t> &overruns);
+  void        publishLatency();
+  std::string latencyReport();
+
+  template <class T>
+  void publishPreallocated(rclcpp::Publisher<T> &publisher, const T &msg);
+
+  bool                     transformBetween(const std::string &frame_from, const std::string &frame_to, geometry_msgs::msg::PoseStamped &pose_out);
+  std_msgs::msg::ColorRGBA generateColor(const double r, const double g, const double b, const double a);
+
+  // callback groups
+  rclcpp::CallbackGroup::SharedPtr callback_group_;            // control loop and mission progress
+  rclcpp::CallbackGroup::SharedPtr telemetry_callback_group_;  // PX4 telemetry, the only writer of the vehicle state
+  rclcpp::CallbackGroup::SharedPtr command_callback_group_;    // services waiting for MAVSDK acknowledgements
+
+  // timers
+  rclcpp::TimerBase::SharedPtr     control_timer_;  // watchdog, the mission progresses on MissionResult messages and wakeups
+  void                             controlRoutine(void);
+  void                             missionRoutine(void);
+  rclcpp::TimerBase::SharedPtr     offboard_timer_;
+  void                             offboardRoutine(void);
+  rclcpp::TimerBase::SharedPtr     latency_timer_;
+};
+//}
+
+/* class ControlInterface //{ */
+class ControlInterface : public rclcpp::Node {
+public:
+  ControlInterface(rclcpp::NodeOptions options);
+  ~ControlInterface();
+
+private:
+  std::string    device_url_;
+  mavsdk::Mavsdk mavsdk_;  // one connection serves all vehicles, they are told apart by their system ID
+
+  std::shared_ptr<FlightRecorder>             recorder_;        // null unless flight_recorder_path is set
+  std::shared_ptr<CommandWorker>              command_worker_;  // a single thread waits for the acknowledgements of all vehicles
+  std::shared_ptr<tf2_ros::Buffer>            tf_buffer_;
+  std::shared_ptr<tf2_ros::TransformListener> tf_listener_;
+
+  rclcpp::TimerBase::SharedPtr connection_timer_;  // retries opening the MAVSDK connection until it succeeds
+
+  // declared last, the vehicles are destroyed before the resources they share
+  // a deque keeps the addresses stable, callbacks of the vehicles are bound to them
+  std::deque<Vehicle> vehicles_;
+
+  bool connectDevice();
+
+  // utils
+  template <class T>
+  bool parse_param(std::string param_name, T &param_dest);
+};
+//}
+
+}  // namespace control_interface
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace control_interface
+{
+
+/* struct flight_record_t //{ */
+// One fixed-size entry of the flight recorder, the meaning of code and values depends on the type.
+// The layout is the file format, append new types and commands at the end and bump flight_recorder_header_t::version on any other change.
+struct flight_record_t
+{
+  enum type_t : uint16_t
+  {
+    odometry,          // values: x, y, z [m] PX4 local NED, yaw [rad]
+    waypoints_queued,  // code: number of waypoints accepted by a service, values: x, y, z, yaw of the last one (local ENU)
+    route_spliced,     // code: number of new waypoints of a streamed route, values: number of waypoints kept from the previous route
+    mission_upload,    // code: items, values: 1 if the plan already on the vehicle was reused, first item to fly
+    command_result,    // code: command_t, values: duration [s], 1 on success
+    state,             // code: state flags, values: link state, buffered waypoints
+    mission_progress,  // code: index of the last reached item, values: mission instance, 1 if finished, MAVLink seq_reached
+    type_count
+  };
+
+  enum command_t : int32_t
+  {
+    arm,
+    disarm,
+    takeoff,
+    land,
+    upload_mission,
+    start_mission,
+    pause_mission,
+    set_current_mission_item,
+    command_count
+  };
+
+  // bits of code of the state records
+  enum state_flag_t : int32_t
+  {
+    armed            = 1 << 0,
+    airborne         = 1 << 1,
+    moving           = 1 << 2,
+    mission_finished = 1 << 3,
+    getting_odom     = 1 << 4,
+    getting_control  = 1 << 5,
+    getting_land     = 1 << 6,
+  };
+
+  static constexpr std::array<const char *, type_count> type_names = {"odometry",       "waypoints_queued", "route_spliced",   "mission_upload",
+                                                                      "command_result", "state",            "mission_progress"};
+  static constexpr std::array<const char *, command_count> command_names = {"arm",           "disarm",        "takeoff",
+                                                                            "land",          "upload_mission", "start_mission",
+                                                                            "pause_mission", "set_current_mission_item"};
+
+  int64_t  stamp;    // [ns] steady clock
+  uint16_t type;
+  uint16_t vehicle;  // MAVLink system ID
+  int32_t  code;
+  double   values[6];
+};
+static_assert(sizeof(flight_record_t) == 64, "flight_record_t is the file format");
+//}
+
+/* struct flight_recorder_header_t //{ */
+// start of the file, followed by capacity records. The record number n is at index n % capacity, so the file wraps around once it is full.
+// The slot at written % capacity is the one being overwritten and may be torn if the node crashed, only the capacity - 1 records before
+// it are valid.
+struct flight_recorder_header_t
+{
+  static constexpr char     magic_value[8] = {'F', '4', 'F', 'R', 'E', 'C', '\0', '\0'};
+  static constexpr uint32_t version_value  = 1;
+
+  char     magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t capacity;       // [records]
+  int64_t  steady_origin;  // [ns] steady clock when the file was created
+  int64_t  system_origin;  // [ns] system clock at the same moment, converts the record stamps to wall time
+  uint64_t written;        // records written so far, updated after every record
+  uint64_t dropped;        // records lost because the queue was full
+  uint64_t reserved;
+};
+static_assert(sizeof(flight_recorder_header_t) == 64, "flight_recorder_header_t is the file format");
+//}
+
+/* class FlightRecorder //{ */
+// Binary log of the vehicle state, commands and MAVSDK results for post-flight analysis. Any thread records into a bounded lock-free queue,
+// which costs one compare-and-swap and a 64 byte copy. A background thread moves the records into a memory-mapped file, so nothing on the
+// flight path formats text or waits for the disk. A record is dropped and counted when the queue is full. Decode a file with
+// flight_recorder_decode.
+class FlightRecorder {
+public:
+  // every call creates a new file, the start time is inserted into path before its extension, e.g. flight.frec -> flight_20260101T120000Z.frec
+  // returns null and sets error if the file cannot be created
+  static std::shared_ptr<FlightRecorder> create(const std::string &path, const size_t file_records, const size_t queue_records,
+                                                const std::chrono::milliseconds flush_period, std::string &error);
+  ~FlightRecorder();
+
+  // of the created file
+  const std::string &path() const {
+    return path_;
+  }
+
+  FlightRecorder(const FlightRecorder &) = delete;
+  FlightRecorder &operator=(const FlightRecorder &) = delete;
+
+  bool record(const flight_record_t::type_t type, const uint16_t vehicle, const int32_t code, std::initializer_list<double> values = {}) {
+    flight_record_t r{};
+    r.stamp   = std::chrono::steady_clock::now().time_since_epoch().count();
+    r.type    = type;
+    r.vehicle = vehicle;
+    r.code    = code;
+    size_t i  = 0;
+    for (auto it = values.begin(); it != values.end() && i < 6; ++it) {
+      r.values[i++] = *it;
+    }
+    return push(r);
+  }
+
+  uint64_t dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+private:
+  FlightRecorder() = default;
+
+  // bounded multi-producer single-consumer queue, every slot carries the position it may be written or read at
+  struct slot_t
+  {
+    std::atomic<uint64_t> sequence;
+    flight_record_t       record;
+  };
+
+  bool push(const flight_record_t &record) {
+    uint64_t position = enqueue_.load(std::memory_order_relaxed);
+    while (true) {
+      slot_t        &slot     = slots_[position & mask_];
+      const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+      const int64_t  diff     = int64_t(sequence) - int64_t(position);
+      if (diff == 0) {
+        if (enqueue_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+          slot.record = record;
+          slot.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      } else {
+        position = enqueue_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void run();
+  void flush();
+
+  std::unique_ptr<slot_t[]> slots_;
+  size_t                    mask_ = 0;
+  alignas(64) std::atomic<uint64_t> enqueue_{0};
+  alignas(64) uint64_t dequeue_ = 0;  // used only by the writer thread
+  std::atomic<uint64_t> dropped_{0};
+
+  std::string               path_;
+  int                       fd_        = -1;
+  size_t                    file_size_ = 0;
+  flight_recorder_header_t *header_    = nullptr;  // mapped file
+  flight_record_t          *records_   = nullptr;
+
+  std::chrono::milliseconds flush_period_{100};
+  std::mutex                mutex_;
+  std::condition_variable   cv_;
+  bool                      stop_ = false;
+  std::thread               thread_;
+};
+//}
+
+}  // namespace control_interface
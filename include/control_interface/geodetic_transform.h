@@ -0,0 +1,176 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+namespace control_interface
+{
+
+/* class GeodeticTransform //{ */
+// Azimuthal equidistant projection around a fixed origin, the same model and earth radius as mavsdk::geometry::CoordinateTransformation.
+// The trigonometry of the origin is evaluated once in the constructor. The batch methods work on structure-of-arrays buffers in blocks of
+// batch_block points: the libm calls of a block run in their own loops, next to the unit conversions only, and write stack scratch arrays.
+// The projection arithmetic between them runs in branch-free loops over those arrays, which the compiler can vectorize.
+// Results agree with MAVSDK to within 1e-6 m (local) and 1e-11 deg (global) for points up to 100 km from the origin.
+class GeodeticTransform {
+public:
+  static constexpr double world_radius = 6371000.0;  // [m], MAVSDK value
+  static constexpr size_t batch_block  = 64;         // points per pass of the batch methods, sized for the stack scratch arrays
+
+  GeodeticTransform(const double ref_latitude_deg, const double ref_longitude_deg)
+      : ref_latitude_deg_(ref_latitude_deg),
+        ref_longitude_deg_(ref_longitude_deg),
+        ref_lat_rad_(toRad(ref_latitude_deg)),
+        ref_lon_rad_(toRad(ref_longitude_deg)),
+        ref_sin_lat_(std::sin(ref_lat_rad_)),
+        ref_cos_lat_(std::cos(ref_lat_rad_)) {
+  }
+
+  double refLatitude() const {
+    return ref_latitude_deg_;
+  }
+
+  double refLongitude() const {
+    return ref_longitude_deg_;
+  }
+
+  /* localFromGlobal //{ */
+  void localFromGlobal(const double latitude_deg, const double longitude_deg, double &east_m, double &north_m) const {
+    const double lat_rad = toRad(latitude_deg);
+    const double d_lon   = toRad(longitude_deg) - ref_lon_rad_;
+    const double sin_lat = std::sin(lat_rad);
+    const double cos_lat = std::cos(lat_rad);
+    const double cos_lon = std::cos(d_lon);
+    const double c       = std::acos(cosDistance(sin_lat, cos_lat, cos_lon));
+    scaleToLocal(c, std::sin(c), sin_lat, cos_lat, std::sin(d_lon), cos_lon, east_m, north_m);
+  }
+
+  // n points, output buffers may not alias the inputs
+  void localFromGlobal(const double *latitude_deg, const double *longitude_deg, double *east_m, double *north_m, const size_t n) const {
+    // the output buffers could alias the members, the origin is read from a local copy so that the final pass does not reload it after every store
+    const GeodeticTransform origin = *this;
+    double sin_lat[batch_block], cos_lat[batch_block], sin_lon[batch_block], cos_lon[batch_block], c[batch_block], sin_c[batch_block];
+    for (size_t start = 0; start < n; start += batch_block) {
+      const size_t  m     = std::min(batch_block, n - start);
+      const double *lat   = latitude_deg + start;
+      const double *lon   = longitude_deg + start;
+      double *      east  = east_m + start;
+      double *      north = north_m + start;
+      for (size_t i = 0; i < m; i++) {
+        const double lat_rad = toRad(lat[i]);
+        const double d_lon   = toRad(lon[i]) - ref_lon_rad_;
+        sin_lat[i]           = std::sin(lat_rad);
+        cos_lat[i]           = std::cos(lat_rad);
+        sin_lon[i]           = std::sin(d_lon);
+        cos_lon[i]           = std::cos(d_lon);
+      }
+      for (size_t i = 0; i < m; i++) {
+        c[i] = cosDistance(sin_lat[i], cos_lat[i], cos_lon[i]);
+      }
+      for (size_t i = 0; i < m; i++) {
+        c[i]     = std::acos(c[i]);
+        sin_c[i] = std::sin(c[i]);
+      }
+      for (size_t i = 0; i < m; i++) {
+        origin.scaleToLocal(c[i], sin_c[i], sin_lat[i], cos_lat[i], sin_lon[i], cos_lon[i], east[i], north[i]);
+      }
+    }
+  }
+  //}
+
+  /* globalFromLocal //{ */
+  void globalFromLocal(const double east_m, const double north_m, double &latitude_deg, double &longitude_deg) const {
+    const double x = north_m / world_radius;
+    const double y = east_m / world_radius;
+    const double c = std::sqrt(x * x + y * y);
+    double       sin_lat, atan_y, atan_x;
+    inverseArguments(x, y, c, std::sin(c), std::cos(c), sin_lat, atan_y, atan_x);
+    toGlobal(c, std::asin(sin_lat), std::atan2(atan_y, atan_x), latitude_deg, longitude_deg);
+  }
+
+  // n points, output buffers may not alias the inputs
+  void globalFromLocal(const double *east_m, const double *north_m, double *latitude_deg, double *longitude_deg, const size_t n) const {
+    double x[batch_block], y[batch_block], c[batch_block], sin_c[batch_block], cos_c[batch_block];
+    for (size_t start = 0; start < n; start += batch_block) {
+      const size_t m = std::min(batch_block, n - start);
+      for (size_t i = 0; i < m; i++) {
+        x[i] = north_m[start + i] / world_radius;
+        y[i] = east_m[start + i] / world_radius;
+        c[i] = x[i] * x[i] + y[i] * y[i];
+      }
+      for (size_t i = 0; i < m; i++) {
+        c[i]     = std::sqrt(c[i]);  // sets errno on a negative argument, which keeps it out of the vectorized loops
+        sin_c[i] = std::sin(c[i]);
+        cos_c[i] = std::cos(c[i]);
+      }
+      // the arguments overwrite x, y and sin_c, which are not needed afterwards
+      for (size_t i = 0; i < m; i++) {
+        inverseArguments(x[i], y[i], c[i], sin_c[i], cos_c[i], x[i], y[i], sin_c[i]);
+      }
+      for (size_t i = 0; i < m; i++) {
+        toGlobal(c[i], std::asin(x[i]), std::atan2(y[i], sin_c[i]), latitude_deg[start + i], longitude_deg[start + i]);
+      }
+    }
+  }
+  //}
+
+private:
+  double ref_latitude_deg_;
+  double ref_longitude_deg_;
+  double ref_lat_rad_;
+  double ref_lon_rad_;
+  double ref_sin_lat_;
+  double ref_cos_lat_;
+
+  static constexpr double tiny = std::numeric_limits<double>::min();
+
+  static double toRad(const double deg) {
+    return deg / 180.0 * M_PI;
+  }
+
+  static double toDeg(const double rad) {
+    return rad / M_PI * 180.0;
+  }
+
+  // cosine of the angular distance from the origin, rounding can push it above 1 at and near the origin, it is clamped so that acos() does not
+  // return NaN there
+  double cosDistance(const double sin_lat, const double cos_lat, const double cos_d_lon) const {
+    return std::clamp(ref_sin_lat_ * sin_lat + ref_cos_lat_ * cos_lat * cos_d_lon, -1.0, 1.0);
+  }
+
+  // c is the angular distance from the origin
+  void scaleToLocal(const double c, const double sin_c, const double sin_lat, const double cos_lat, const double sin_d_lon, const double cos_d_lon,
+                    double &east_m, double &north_m) const {
+    // c / sin(c), and exactly 1 below epsilon where sin(c) rounds to c, the smallest double changes neither operand above it
+    // this gives the results of the MAVSDK branch without a branch, which would keep the compiler from vectorizing the loop
+    const double k = (c + tiny) / (sin_c + tiny);
+    north_m        = k * (ref_cos_lat_ * sin_lat - ref_sin_lat_ * cos_lat * cos_d_lon) * world_radius;
+    east_m         = k * cos_lat * sin_d_lon * world_radius;
+  }
+
+  // arguments of asin() and atan2() of the inverse projection, the outputs may be the variables passed as the inputs
+  void inverseArguments(const double x, const double y, const double c, const double sin_c, const double cos_c, double &sin_lat, double &atan_y,
+                        double &atan_x) const {
+    const double s   = (x * sin_c * ref_cos_lat_) / (c + tiny);  // branch-free like scaleToLocal(), x is 0 at the origin, which toGlobal() resolves
+    const double a_y = y * sin_c;
+    const double a_x = c * ref_cos_lat_ * cos_c - x * ref_sin_lat_ * sin_c;
+    sin_lat          = cos_c * ref_sin_lat_ + s;
+    atan_y           = a_y;
+    atan_x           = a_x;
+  }
+
+  void toGlobal(const double c, const double lat_rad, const double d_lon_rad, double &latitude_deg, double &longitude_deg) const {
+    if (std::fabs(c) > 0) {
+      latitude_deg  = toDeg(lat_rad);
+      longitude_deg = toDeg(ref_lon_rad_ + d_lon_rad);
+    } else {
+      latitude_deg  = ref_latitude_deg_;
+      longitude_deg = ref_longitude_deg_;
+    }
+  }
+};
+//}
+
+}  // namespace control_interface
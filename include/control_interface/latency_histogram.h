@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace control_interface
+{
+
+/* class LatencyHistogram //{ */
+// Lock-free histogram of durations with power-of-two microsecond buckets, bucket i counts durations in [2^(i-1), 2^i) us, bucket 0 counts
+// durations below 1 us. Any number of threads may record and read concurrently, a snapshot taken during a record may be off by that one sample.
+class LatencyHistogram {
+public:
+  static constexpr size_t bucket_count = 32;  // the last bucket also holds everything above 2^30 us
+
+  struct snapshot_t
+  {
+    uint64_t                           count  = 0;
+    uint64_t                           sum_us = 0;
+    uint64_t                           max_us = 0;
+    std::array<uint64_t, bucket_count> buckets{};
+
+    double meanUs() const {
+      return count > 0 ? double(sum_us) / double(count) : 0.0;
+    }
+
+    // upper bound of the bucket which contains the given quantile, q in [0, 1]
+    uint64_t quantileUs(const double q) const {
+      const uint64_t rank = uint64_t(q * double(count));
+      uint64_t       seen = 0;
+      for (size_t i = 0; i < bucket_count; i++) {
+        seen += buckets[i];
+        if (seen > rank) {
+          return std::min(bucketUpperUs(i), max_us);
+        }
+      }
+      return max_us;
+    }
+  };
+
+  LatencyHistogram() = default;
+
+  LatencyHistogram(const LatencyHistogram &) = delete;
+  LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+  void record(const std::chrono::steady_clock::duration duration) {
+    const auto     us     = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    const uint64_t value  = us > 0 ? uint64_t(us) : 0;
+    const size_t   bucket = std::min(bucketOf(value), bucket_count - 1);
+
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_us_.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t max = max_us_.load(std::memory_order_relaxed);
+    while (value > max && !max_us_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+  }
+
+  snapshot_t snapshot() const {
+    snapshot_t s;
+    s.count  = count_.load(std::memory_order_relaxed);
+    s.sum_us = sum_us_.load(std::memory_order_relaxed);
+    s.max_us = max_us_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < bucket_count; i++) {
+      s.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    }
+    return s;
+  }
+
+  void reset() {
+    for (auto &b : buckets_) {
+      b.store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    sum_us_.store(0, std::memory_order_relaxed);
+    max_us_.store(0, std::memory_order_relaxed);
+  }
+
+  static uint64_t bucketUpperUs(const size_t bucket) {
+    return uint64_t(1) << bucket;
+  }
+
+private:
+  std::array<std::atomic<uint64_t>, bucket_count> buckets_{};
+  std::atomic<uint64_t>                           count_  = 0;
+  std::atomic<uint64_t>                           sum_us_ = 0;
+  std::atomic<uint64_t>                           max_us_ = 0;
+
+  // number of significant bits, 0 -> 0, 1 -> 1, 2..3 -> 2, 4..7 -> 3, ...
+  static size_t bucketOf(uint64_t value) {
+    size_t bits = 0;
+    while (value > 0) {
+      value >>= 1;
+      bits++;
+    }
+    return bits;
+  }
+};
+//}
+
+/* class ScopedLatency //{ */
+// records the lifetime of the object into a histogram
+class ScopedLatency {
+public:
+  explicit ScopedLatency(LatencyHistogram &histogram) : histogram_(histogram), start_(std::chrono::steady_clock::now()) {
+  }
+
+  ~ScopedLatency() {
+    histogram_.record(std::chrono::steady_clock::now() - start_);
+  }
+
+  ScopedLatency(const ScopedLatency &) = delete;
+  ScopedLatency &operator=(const ScopedLatency &) = delete;
+
+private:
+  LatencyHistogram &                    histogram_;
+  std::chrono::steady_clock::time_point start_;
+};
+//}
+
+}  // namespace control_interface
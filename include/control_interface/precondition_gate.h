@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace control_interface
+{
+
+/* class PreconditionGate //{ */
+// Readiness of a vehicle packed into a single atomic word. Writers set or clear one condition at a time, services check all the conditions
+// they require with one acquire load, so a rejected request costs a few nanoseconds. Whatever a writer prepares before it sets a condition,
+// e.g. the command channel before connected, is visible to a service which finds the condition set. Rejections are counted per reason and the gate decides
+// when a rejection is logged, at most once per log period and reason, so that a client spamming a service cannot flood the log.
+class PreconditionGate {
+public:
+  // in the order the services report them, the first unmet condition is the reason of the rejection
+  enum condition_t : uint32_t
+  {
+    initialized,
+    sensors,  // all Pixhawk sensors are being received
+    connected,
+    armed,
+    landed,
+    airborne,
+    condition_count
+  };
+
+  using mask_t = uint32_t;
+
+  static constexpr std::array<const char *, condition_count> reasons = {"not initialized",      "missing Pixhawk sensors", "vehicle not connected",
+                                                                        "vehicle not armed",    "vehicle not landed",      "vehicle not airborne"};
+  static constexpr std::array<const char *, condition_count> keys    = {"not_initialized", "missing_sensors", "not_connected",
+                                                                        "not_armed",       "not_landed",      "not_airborne"};
+
+  // conditions required by one service and its rejection messages, built once when the service is created
+  struct guard_t
+  {
+    mask_t                                    required = 0;
+    std::array<std::string, condition_count> messages;
+  };
+
+  explicit PreconditionGate(const std::chrono::steady_clock::duration log_period = std::chrono::seconds(1)) : log_period_(log_period.count()) {
+  }
+
+  PreconditionGate(const PreconditionGate &) = delete;
+  PreconditionGate &operator=(const PreconditionGate &) = delete;
+
+  static constexpr mask_t mask(const condition_t c) {
+    return mask_t(1) << c;
+  }
+
+  template <class... Cs>
+  static constexpr mask_t mask(const condition_t c, const Cs... cs) {
+    return mask(c) | mask(cs...);
+  }
+
+  // messages are "<action>, <reason>", e.g. "Takeoff rejected, vehicle not armed"
+  static guard_t guard(const std::string &action, const mask_t required) {
+    guard_t g;
+    g.required = required;
+    for (size_t i = 0; i < condition_count; i++) {
+      g.messages[i] = action + ", " + reasons[i];
+    }
+    return g;
+  }
+
+  void set(const condition_t c, const bool value) {
+    if (value) {
+      state_.fetch_or(mask(c), std::memory_order_release);
+    } else {
+      state_.fetch_and(~mask(c), std::memory_order_release);
+    }
+  }
+
+  // returns condition_count if all the required conditions hold, otherwise the first one which does not
+  condition_t check(const mask_t required) const {
+    const mask_t missing = required & ~state_.load(std::memory_order_acquire);
+    if (missing == 0) {
+      return condition_count;
+    }
+    return condition_t(__builtin_ctz(missing));
+  }
+
+  // counts the rejection, returns true if it should be logged
+  bool reject(const condition_t c) {
+    rejections_[c].fetch_add(1, std::memory_order_relaxed);
+    const int64_t now  = std::chrono::steady_clock::now().time_since_epoch().count();
+    int64_t       last = last_log_[c].load(std::memory_order_relaxed);
+    return now - last >= log_period_ && last_log_[c].compare_exchange_strong(last, now, std::memory_order_relaxed);
+  }
+
+  uint64_t rejections(const condition_t c) const {
+    return rejections_[c].load(std::memory_order_relaxed);
+  }
+
+  void resetRejections() {
+    for (auto &r : rejections_) {
+      r.store(0, std::memory_order_relaxed);
+    }
+  }
+
+private:
+  std::atomic<mask_t>                               state_ = 0;
+  std::array<std::atomic<uint64_t>, condition_count> rejections_{};
+  std::array<std::atomic<int64_t>, condition_count>  last_log_{};  // [steady clock ticks]
+  const int64_t                                     log_period_;  // [steady clock ticks]
+};
+//}
+
+}  // namespace control_interface
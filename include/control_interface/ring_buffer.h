@@ -0,0 +1,204 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+namespace control_interface
+{
+
+/* class RingBuffer //{ */
+// Fixed-capacity double-ended buffer for a single owner thread. All slots are allocated up front and the elements stay in one contiguous
+// block, push_back() fails instead of growing when the buffer is full.
+template <class T>
+class RingBuffer {
+public:
+  // holds the index from the front, the full random access set lets the standard algorithms dispatch on the tag
+  template <class BufferT, class ValueT>
+  class iterator_t {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type        = T;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = ValueT *;
+    using reference         = ValueT &;
+
+    iterator_t() : buffer_(nullptr), index_(0) {
+    }
+    iterator_t(BufferT *buffer, const size_t index) : buffer_(buffer), index_(index) {
+    }
+
+    reference operator*() const {
+      return (*buffer_)[index_];
+    }
+    pointer operator->() const {
+      return &(*buffer_)[index_];
+    }
+    reference operator[](const difference_type n) const {
+      return (*buffer_)[index_ + n];
+    }
+
+    iterator_t &operator++() {
+      index_++;
+      return *this;
+    }
+    iterator_t operator++(int) {
+      iterator_t previous = *this;
+      index_++;
+      return previous;
+    }
+    iterator_t &operator--() {
+      index_--;
+      return *this;
+    }
+    iterator_t operator--(int) {
+      iterator_t previous = *this;
+      index_--;
+      return previous;
+    }
+
+    iterator_t &operator+=(const difference_type n) {
+      index_ += n;
+      return *this;
+    }
+    iterator_t &operator-=(const difference_type n) {
+      index_ -= n;
+      return *this;
+    }
+    iterator_t operator+(const difference_type n) const {
+      return iterator_t(buffer_, index_ + n);
+    }
+    friend iterator_t operator+(const difference_type n, const iterator_t &it) {
+      return it + n;
+    }
+    iterator_t operator-(const difference_type n) const {
+      return iterator_t(buffer_, index_ - n);
+    }
+    difference_type operator-(const iterator_t &other) const {
+      return difference_type(index_) - difference_type(other.index_);
+    }
+
+    bool operator==(const iterator_t &other) const {
+      return index_ == other.index_;
+    }
+    bool operator!=(const iterator_t &other) const {
+      return index_ != other.index_;
+    }
+    bool operator<(const iterator_t &other) const {
+      return index_ < other.index_;
+    }
+    bool operator>(const iterator_t &other) const {
+      return index_ > other.index_;
+    }
+    bool operator<=(const iterator_t &other) const {
+      return index_ <= other.index_;
+    }
+    bool operator>=(const iterator_t &other) const {
+      return index_ >= other.index_;
+    }
+
+  private:
+    BufferT *buffer_;
+    size_t   index_;
+  };
+
+  using iterator       = iterator_t<RingBuffer, T>;
+  using const_iterator = iterator_t<const RingBuffer, const T>;
+
+  explicit RingBuffer(const size_t capacity) : slots_(capacity) {
+  }
+
+  RingBuffer(const RingBuffer &) = delete;
+  RingBuffer &operator=(const RingBuffer &) = delete;
+
+  bool push_back(const T &item) {
+    if (size_ == slots_.size()) {
+      return false;
+    }
+    slots_[wrap(head_ + size_)] = item;
+    size_++;
+    return true;
+  }
+
+  // appends as many items as fit, returns their number
+  template <class InputIt>
+  size_t append(InputIt first, InputIt last) {
+    size_t appended = 0;
+    for (; first != last && push_back(*first); ++first) {
+      appended++;
+    }
+    return appended;
+  }
+
+  void pop_front() {
+    head_ = wrap(head_ + 1);
+    size_--;
+  }
+
+  // keeps the first count items
+  void truncate(const size_t count) {
+    if (count < size_) {
+      size_ = count;
+    }
+  }
+
+  void clear() {
+    head_ = 0;
+    size_ = 0;
+  }
+
+  T &front() {
+    return slots_[head_];
+  }
+  const T &front() const {
+    return slots_[head_];
+  }
+
+  T &operator[](const size_t index) {
+    return slots_[wrap(head_ + index)];
+  }
+  const T &operator[](const size_t index) const {
+    return slots_[wrap(head_ + index)];
+  }
+
+  iterator begin() {
+    return iterator(this, 0);
+  }
+  iterator end() {
+    return iterator(this, size_);
+  }
+  const_iterator begin() const {
+    return const_iterator(this, 0);
+  }
+  const_iterator end() const {
+    return const_iterator(this, size_);
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  size_t capacity() const {
+    return slots_.size();
+  }
+
+  size_t available() const {
+    return slots_.size() - size_;
+  }
+
+private:
+  std::vector<T> slots_;
+  size_t         head_ = 0;
+  size_t         size_ = 0;
+
+  size_t wrap(const size_t index) const {
+    return index < slots_.size() ? index : index - slots_.size();
+  }
+};
+//}
+
+}  // namespace control_interface
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+
+namespace control_interface
+{
+
+/* class SensorFreshness //{ */
+// Receive time and rate of one telemetry topic. A single subscription callback records the messages, any thread may ask whether the topic is
+// fresh, i.e. its last message is not older than the timeout. The rate is a moving average of the receive intervals, so it reacts within
+// a few messages and does not need a window of timestamps. What the callback writes before its first message is recorded is visible to a
+// thread which then finds the topic received.
+class SensorFreshness {
+public:
+  using clock_t = std::chrono::steady_clock;
+
+  SensorFreshness() = default;
+
+  SensorFreshness(const SensorFreshness &) = delete;
+  SensorFreshness &operator=(const SensorFreshness &) = delete;
+
+  // set before the subscription is created
+  void setTimeout(const double timeout) {
+    timeout_ = std::chrono::duration_cast<clock_t::duration>(std::chrono::duration<double>(timeout)).count();
+  }
+
+  double timeout() const {
+    return std::chrono::duration<double>(clock_t::duration(timeout_)).count();
+  }
+
+  // returns true if the topic was not fresh before this message
+  bool received(const clock_t::time_point now) {
+    const int64_t stamp = now.time_since_epoch().count();
+    const int64_t last  = last_.load(std::memory_order_relaxed);
+    if (last != 0) {
+      // the first interval seeds the average, then every interval moves it by 1/8
+      const int64_t interval = stamp - last;
+      const int64_t average  = interval_.load(std::memory_order_relaxed);
+      interval_.store(average == 0 ? interval : average + (interval - average) / 8, std::memory_order_relaxed);
+    }
+    last_.store(stamp, std::memory_order_release);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    return last == 0 || stamp - last > timeout_;
+  }
+
+  bool everReceived() const {
+    return last_.load(std::memory_order_acquire) != 0;
+  }
+
+  bool fresh(const clock_t::time_point now) const {
+    const int64_t last = last_.load(std::memory_order_acquire);
+    return last != 0 && now.time_since_epoch().count() - last <= timeout_;
+  }
+
+  // [s] time since the last message, infinity if none has been received
+  double age(const clock_t::time_point now) const {
+    const int64_t last = last_.load(std::memory_order_relaxed);
+    if (last == 0) {
+      return std::numeric_limits<double>::infinity();
+    }
+    return std::chrono::duration<double>(clock_t::duration(now.time_since_epoch().count() - last)).count();
+  }
+
+  // [Hz] average rate, decays once no message comes for longer than the average interval
+  double rate(const clock_t::time_point now) const {
+    const int64_t average = interval_.load(std::memory_order_relaxed);
+    if (average <= 0) {
+      return 0.0;
+    }
+    const double interval = std::chrono::duration<double>(clock_t::duration(average)).count();
+    return 1.0 / std::max(interval, age(now));
+  }
+
+  uint64_t count() const {
+    return count_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<int64_t>  last_     = 0;  // [steady clock ticks] 0 until the first message
+  std::atomic<int64_t>  interval_ = 0;  // [steady clock ticks] moving average of the receive intervals
+  std::atomic<uint64_t> count_    = 0;
+  int64_t               timeout_  = std::chrono::duration_cast<clock_t::duration>(std::chrono::seconds(1)).count();  // [steady clock ticks]
+};
+//}
+
+}  // namespace control_interface
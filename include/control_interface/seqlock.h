@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace control_interface
+{
+
+/* class SeqLock //{ */
+// Lock-free snapshot of a small trivially copyable value with a single writer and any number of readers.
+// Readers retry while a write is in progress, so they never observe a torn value and never block the writer.
+template <class T>
+class SeqLock {
+  static_assert(std::is_trivially_copyable_v<T>, "SeqLock requires a trivially copyable type");
+
+public:
+  SeqLock() {
+    store(T{});
+  }
+
+  explicit SeqLock(const T &value) {
+    store(value);
+  }
+
+  SeqLock(const SeqLock &) = delete;
+  SeqLock &operator=(const SeqLock &) = delete;
+
+  // must only be called from one thread at a time
+  void store(const T &value) {
+    std::array<uint64_t, words_> buffer{};
+    std::memcpy(buffer.data(), &value, sizeof(T));
+
+    const uint32_t seq = seq_.load(std::memory_order_relaxed);
+    seq_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < words_; i++) {
+      data_[i].store(buffer[i], std::memory_order_relaxed);
+    }
+    seq_.store(seq + 2, std::memory_order_release);
+  }
+
+  T load() const {
+    std::array<uint64_t, words_> buffer;
+    uint32_t                     seq_before;
+    uint32_t                     seq_after;
+    do {
+      seq_before = seq_.load(std::memory_order_acquire);
+      for (size_t i = 0; i < words_; i++) {
+        buffer[i] = data_[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      seq_after = seq_.load(std::memory_order_relaxed);
+    } while ((seq_before & 1) || seq_before != seq_after);
+
+    T value;
+    std::memcpy(&value, buffer.data(), sizeof(T));
+    return value;
+  }
+
+private:
+  static constexpr size_t words_ = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+  std::atomic<uint32_t>                      seq_{0};
+  std::array<std::atomic<uint64_t>, words_> data_{};
+};
+//}
+
+}  // namespace control_interface
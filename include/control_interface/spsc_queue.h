@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace control_interface
+{
+
+/* class SpscQueue //{ */
+// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+// All slots are allocated up front, push() fails instead of growing when the queue is full.
+template <class T>
+class SpscQueue {
+public:
+  explicit SpscQueue(const size_t capacity) : size_(capacity + 1), slots_(new T[capacity + 1]) {
+  }
+
+  SpscQueue(const SpscQueue &) = delete;
+  SpscQueue &operator=(const SpscQueue &) = delete;
+
+  // producer side, the item is left untouched when the queue is full
+  bool push(T &&item) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t next = increment(tail);
+    if (next == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    slots_[tail] = std::move(item);
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // consumer side
+  bool pop(T &item) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = std::move(slots_[head]);
+    head_.store(increment(head), std::memory_order_release);
+    return true;
+  }
+
+  // approximate when called concurrently with push() or pop()
+  size_t size() const {
+    const size_t head = head_.load(std::memory_order_acquire);
+    const size_t tail = tail_.load(std::memory_order_acquire);
+    return tail >= head ? tail - head : tail + size_ - head;
+  }
+
+  size_t capacity() const {
+    return size_ - 1;
+  }
+
+private:
+  size_t increment(const size_t index) const {
+    return index + 1 == size_ ? 0 : index + 1;
+  }
+
+  const size_t         size_;
+  std::unique_ptr<T[]> slots_;
+
+  // producer and consumer indices live on separate cache lines
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+};
+//}
+
+}  // namespace control_interface
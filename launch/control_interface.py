@@ -40,9 +40,12 @@ def generate_launch_description():
                 ],
                 remappings=[
                     ("~/vehicle_command_out", "/" + DRONE_DEVICE_ID + "/fmu/vehicle_command/in"),
+                    ("~/offboard_control_mode_out", "/" + DRONE_DEVICE_ID + "/fmu/offboard_control_mode/in"),
+                    ("~/trajectory_setpoint_out", "/" + DRONE_DEVICE_ID + "/fmu/trajectory_setpoint/in"),
                     ("~/local_odom_out", "~/local_odom"),
                     ("~/desired_pose_out", "~/desired_pose"),
                     ("~/diagnostics_out", "~/diagnostics"),
+                    ("~/latency_out", "~/latency"),
                     ("~/debug_markers_out", "~/debug/waypoint_markers"),
 
                     ("~/octomap_reset_out", "/" + DRONE_DEVICE_ID + "/octomap_server/reset"),
@@ -52,6 +55,7 @@ def generate_launch_description():
                     ("~/control_mode_in", "/" + DRONE_DEVICE_ID + "/fmu/vehicle_control_mode/out"),
                     ("~/land_detected_in", "/" + DRONE_DEVICE_ID + "/fmu/vehicle_land_detected/out"),
                     ("~/mission_result_in", "/" + DRONE_DEVICE_ID + "/fmu/mission_result/out"),
+                    ("~/timesync_in", "/" + DRONE_DEVICE_ID + "/fmu/timesync/out"),
 
                     ("~/arming_in", "~/arming"),
                     ("~/takeoff_in", "~/takeoff"),
@@ -60,10 +64,15 @@ def generate_launch_description():
                     ("~/local_path_in", "~/local_path"),
                     ("~/gps_waypoint_in", "~/gps_waypoint"),
                     ("~/gps_path_in", "~/gps_path"),
+                    ("~/waypoint_stream_in", "~/waypoint_stream"),
                     
                     ("~/waypoint_to_local_in", "~/waypoint_to_local"),
                     ("~/path_to_local_in", "~/path_to_local"),
+                    ("~/latency_dump_in", "~/latency_dump"),
+                    ("~/latency_reset_in", "~/latency_reset"),
                 ],
+                # components loaded into the same container receive the odometry and desired pose without serialization
+                extra_arguments=[{"use_intra_process_comms": True}],
             ),
         ],
         output='screen',
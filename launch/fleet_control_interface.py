@@ -0,0 +1,103 @@
+import launch
+from ament_index_python.packages import get_package_share_directory
+from launch_ros.actions import Node
+from launch_ros.actions import ComposableNodeContainer
+from launch_ros.descriptions import ComposableNode
+import os
+import sys
+
+# one control_interface node drives all vehicles listed in FLEET_DEVICE_IDS (e.g. "uav1,uav2,uav3") over a single MAVSDK connection
+# FLEET_SYSTEM_IDS optionally lists their MAVLink system IDs in the same order, the default is 1, 2, 3, ...
+
+def vehicle_remappings(name):
+    prefix = "~/" + name + "/"
+    return [
+        (prefix + "vehicle_command_out", "/" + name + "/fmu/vehicle_command/in"),
+        (prefix + "offboard_control_mode_out", "/" + name + "/fmu/offboard_control_mode/in"),
+        (prefix + "trajectory_setpoint_out", "/" + name + "/fmu/trajectory_setpoint/in"),
+        (prefix + "local_odom_out", prefix + "local_odom"),
+        (prefix + "desired_pose_out", prefix + "desired_pose"),
+        (prefix + "diagnostics_out", prefix + "diagnostics"),
+        (prefix + "latency_out", prefix + "latency"),
+        (prefix + "debug_markers_out", prefix + "debug/waypoint_markers"),
+
+        (prefix + "octomap_reset_out", "/" + name + "/octomap_server/reset"),
+
+        (prefix + "gps_in", "/" + name + "/fmu/vehicle_global_position/out"),
+        (prefix + "pixhawk_odom_in", "/" + name + "/fmu/vehicle_odometry/out"),
+        (prefix + "control_mode_in", "/" + name + "/fmu/vehicle_control_mode/out"),
+        (prefix + "land_detected_in", "/" + name + "/fmu/vehicle_land_detected/out"),
+        (prefix + "mission_result_in", "/" + name + "/fmu/mission_result/out"),
+        (prefix + "timesync_in", "/" + name + "/fmu/timesync/out"),
+
+        (prefix + "arming_in", prefix + "arming"),
+        (prefix + "takeoff_in", prefix + "takeoff"),
+        (prefix + "land_in", prefix + "land"),
+        (prefix + "local_waypoint_in", prefix + "local_waypoint"),
+        (prefix + "local_path_in", prefix + "local_path"),
+        (prefix + "gps_waypoint_in", prefix + "gps_waypoint"),
+        (prefix + "gps_path_in", prefix + "gps_path"),
+        (prefix + "waypoint_stream_in", prefix + "waypoint_stream"),
+
+        (prefix + "waypoint_to_local_in", prefix + "waypoint_to_local"),
+        (prefix + "path_to_local_in", prefix + "path_to_local"),
+        (prefix + "latency_dump_in", prefix + "latency_dump"),
+        (prefix + "latency_reset_in", prefix + "latency_reset"),
+    ]
+
+def generate_launch_description():
+
+    ld = launch.LaunchDescription()
+
+    pkg_name = "control_interface"
+    pkg_share_path = get_package_share_directory(pkg_name)
+    
+    ld.add_action(launch.actions.DeclareLaunchArgument("use_sim_time", default_value="false"))
+
+    ld.add_action(launch.actions.DeclareLaunchArgument("debug", default_value="false"))
+    dbg_sub = None
+    if sys.stdout.isatty():
+        dbg_sub = launch.substitutions.PythonExpression(['"" if "false" == "', launch.substitutions.LaunchConfiguration("debug"), '" else "debug_ros2launch ' + os.ttyname(sys.stdout.fileno()) + '"'])
+
+    fleet = [name.strip() for name in os.getenv('FLEET_DEVICE_IDS', '').split(',') if name.strip()]
+    if len(fleet) == 0:
+        raise RuntimeError("Environment variable FLEET_DEVICE_IDS is empty, list the vehicle names separated by commas")
+
+    system_ids = os.getenv('FLEET_SYSTEM_IDS')
+    if system_ids:
+        system_ids = [int(i) for i in system_ids.split(',')]
+    else:
+        system_ids = list(range(1, len(fleet) + 1))
+
+    remappings = []
+    for name in fleet:
+        remappings += vehicle_remappings(name)
+
+    ld.add_action(ComposableNodeContainer(
+        namespace='',
+        name='fleet_control_interface',
+        package='rclcpp_components',
+        executable='component_container_mt',
+        composable_node_descriptions=[
+            ComposableNode(
+                package=pkg_name,
+                plugin='control_interface::ControlInterface',
+                namespace='',
+                name='control_interface',
+                parameters=[
+                    pkg_share_path + '/config/control_interface.yaml',
+                    {"use_sim_time": launch.substitutions.LaunchConfiguration("use_sim_time")},
+                    {"param_namespace.fleet": fleet},
+                    {"param_namespace.fleet_system_ids": system_ids},
+                ],
+                remappings=remappings,
+                # components loaded into the same container receive the odometry and desired pose without serialization
+                extra_arguments=[{"use_intra_process_comms": True}],
+            ),
+        ],
+        output='screen',
+        prefix=dbg_sub,
+        parameters=[{"use_sim_time": launch.substitutions.LaunchConfiguration("use_sim_time")},],
+    ))
+
+    return ld
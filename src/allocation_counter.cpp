@@ -0,0 +1,52 @@
+#include <control_interface/allocation_counter.h>
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+thread_local uint64_t allocations = 0;
+}
+
+uint64_t control_interface::threadAllocations() {
+  return allocations;
+}
+
+/* global allocation functions //{ */
+void *operator new(std::size_t size) {
+  allocations++;
+  if (void *ptr = std::malloc(size > 0 ? size : 1)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  allocations++;
+  return std::malloc(size > 0 ? size : 1);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return operator new(size, std::nothrow);
+}
+
+void operator delete(void *ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept {
+  std::free(ptr);
+}
+//}
@@ -1,35 +1,11 @@
-#include <eigen3/Eigen/Dense>
-#include <fog_msgs/srv/waypoint_to_local.hpp>
-#include <fog_msgs/srv/path_to_local.hpp>
-#include <fog_msgs/srv/path.hpp>
-#include <fog_msgs/srv/vec4.hpp>
-#include <fog_msgs/msg/control_interface_diagnostics.hpp>
-#include <geometry_msgs/msg/transform_stamped.hpp>
-#include <geometry_msgs/msg/pose_array.hpp>
-#include <mavsdk/geometry.h>
-#include <mavsdk/mavsdk.h>
-#include <mavsdk/plugins/action/action.h>
-#include <mavsdk/plugins/mission/mission.h>
-#include <nav_msgs/msg/odometry.hpp>
-#include <px4_msgs/msg/mission_result.hpp>
-#include <px4_msgs/msg/vehicle_command.hpp>
-#include <px4_msgs/msg/vehicle_control_mode.hpp>
-#include <px4_msgs/msg/vehicle_global_position.hpp>
-#include <px4_msgs/msg/vehicle_land_detected.hpp>
-#include <px4_msgs/msg/vehicle_odometry.hpp>
-#include <rclcpp/rclcpp.hpp>
-#include <rclcpp/time.hpp>
-#include <std_msgs/msg/color_rgba.hpp>
-#include <std_srvs/srv/set_bool.hpp>
-#include <std_srvs/srv/trigger.hpp>
-#include <std_srvs/srv/empty.hpp>
+#include <control_interface/control_interface.h>
 #include <tf2/LinearMath/Quaternion.h>
 #include <tf2_geometry_msgs/tf2_geometry_msgs.h>  // This has to be here otherwise you will get cryptic linker error about missing function 'getTimestamp'
-#include <tf2_ros/static_transform_broadcaster.h>
-#include <tf2_ros/transform_broadcaster.h>
-#include <tf2_ros/transform_listener.h>
-#include <visualization_msgs/msg/marker_array.hpp>
-#include <deque>
+#include <control_interface/allocation_counter.h>
+#include <common/mavlink.h>
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
 
 using namespace std::placeholders;
 
@@ -37,38 +13,39 @@ namespace control_interface
 {
 
 
-struct local_waypoint_t
-{
-  double x;
-  double y;
-  double z;
-  double yaw;
-};
-
-struct gps_waypoint_t
-{
-  double latitude;
-  double longitude;
-  double altitude;
-  double yaw;
-};
-
 /* getYaw //{ */
+// heading of the ZYX (yaw-pitch-roll) decomposition, computed directly from the quaternion
+// unlike eulerAngles() this does not build a rotation matrix and does not flip by pi when roll becomes negative
+inline double yawFromQuaternion(const double w, const double x, const double y, const double z) {
+  return std::atan2(2.0 * (w * z + x * y), 1.0 - 2.0 * (y * y + z * z));
+}
+
 double getYaw(const Eigen::Quaterniond &q) {
-  auto euler = q.toRotationMatrix().eulerAngles(0, 1, 2);
-  return euler[2];
+  return yawFromQuaternion(q.w(), q.x(), q.y(), q.z());
 }
 
 double getYaw(const geometry_msgs::msg::Quaternion &q) {
-  Eigen::Quaterniond eq(q.w, q.x, q.y, q.z);
-  auto               euler = eq.toRotationMatrix().eulerAngles(0, 1, 2);
-  return euler[2];
+  return yawFromQuaternion(q.w, q.x, q.y, q.z);
 }
 
 double getYaw(const float q[4]) {
-  Eigen::Quaterniond eq(q[0], q[1], q[2], q[3]);
-  auto               euler = eq.toRotationMatrix().eulerAngles(0, 1, 2);
-  return euler[2];
+  return yawFromQuaternion(q[0], q[1], q[2], q[3]);
+}
+
+// yaw of every pose in the path, the arithmetic is done in a separate branch-free pass so that it can be vectorized
+std::vector<double> getYaw(const nav_msgs::msg::Path &path) {
+  const size_t        n = path.poses.size();
+  std::vector<double> sin_term(n);
+  std::vector<double> cos_term(n);
+  for (size_t i = 0; i < n; i++) {
+    const auto &q = path.poses[i].pose.orientation;
+    sin_term[i]   = 2.0 * (q.w * q.z + q.x * q.y);
+    cos_term[i]   = 1.0 - 2.0 * (q.y * q.y + q.z * q.z);
+  }
+  for (size_t i = 0; i < n; i++) {
+    sin_term[i] = std::atan2(sin_term[i], cos_term[i]);
+  }
+  return sin_term;
 }
 //}
 
@@ -85,65 +62,70 @@ double degToRad(const double &angle_deg) {
 /* coordinate system conversions //{ */
 
 /* globalToLocal //{ */
-std::pair<double, double> globalToLocal(const std::shared_ptr<mavsdk::geometry::CoordinateTransformation> &coord_transform, const double &latitude_deg,
-                                        const double &longitude_deg) {
-  mavsdk::geometry::CoordinateTransformation::GlobalCoordinate global;
-  global.latitude_deg  = latitude_deg;
-  global.longitude_deg = longitude_deg;
-  auto local           = coord_transform->local_from_global(global);
-  return {local.east_m, local.north_m};
-}
-
-local_waypoint_t globalToLocal(const std::shared_ptr<mavsdk::geometry::CoordinateTransformation> &coord_transform, const gps_waypoint_t &wg) {
-  local_waypoint_t                                             wl;
-  mavsdk::geometry::CoordinateTransformation::GlobalCoordinate global;
-  global.latitude_deg  = wg.latitude;
-  global.longitude_deg = wg.longitude;
-  auto local           = coord_transform->local_from_global(global);
-  wl.x                 = local.east_m;
-  wl.y                 = local.north_m;
-  wl.z                 = wg.altitude;
-  wl.yaw               = wg.yaw;
+std::pair<double, double> globalToLocal(const std::shared_ptr<GeodeticTransform> &coord_transform, const double &latitude_deg, const double &longitude_deg) {
+  double east, north;
+  coord_transform->localFromGlobal(latitude_deg, longitude_deg, east, north);
+  return {east, north};
+}
+
+local_waypoint_t globalToLocal(const std::shared_ptr<GeodeticTransform> &coord_transform, const gps_waypoint_t &wg) {
+  local_waypoint_t wl;
+  coord_transform->localFromGlobal(wg.latitude, wg.longitude, wl.x, wl.y);
+  wl.z   = wg.altitude;
+  wl.yaw = wg.yaw;
   return wl;
 }
 
-std::vector<local_waypoint_t> globalToLocal(const std::shared_ptr<mavsdk::geometry::CoordinateTransformation> &coord_transform,
-                                            const std::vector<gps_waypoint_t> &                                wgs) {
-  std::vector<local_waypoint_t> wls;
-  for (const auto &wg : wgs) {
-    wls.push_back(globalToLocal(coord_transform, wg));
+std::vector<local_waypoint_t> globalToLocal(const std::shared_ptr<GeodeticTransform> &coord_transform, const std::vector<gps_waypoint_t> &wgs) {
+  const size_t        n = wgs.size();
+  std::vector<double> lat(n), lon(n), east(n), north(n);
+  for (size_t i = 0; i < n; i++) {
+    lat[i] = wgs[i].latitude;
+    lon[i] = wgs[i].longitude;
+  }
+  coord_transform->localFromGlobal(lat.data(), lon.data(), east.data(), north.data(), n);
+
+  std::vector<local_waypoint_t> wls(n);
+  for (size_t i = 0; i < n; i++) {
+    wls[i].x   = east[i];
+    wls[i].y   = north[i];
+    wls[i].z   = wgs[i].altitude;
+    wls[i].yaw = wgs[i].yaw;
   }
   return wls;
 }
 //}
 
 /* localToGlobal //{ */
-std::pair<double, double> localToGlobal(const std::shared_ptr<mavsdk::geometry::CoordinateTransformation> &coord_transform, const double &x, const double &y) {
-  mavsdk::geometry::CoordinateTransformation::LocalCoordinate local;
-  local.north_m = y;
-  local.east_m  = x;
-  auto global   = coord_transform->global_from_local(local);
-  return {global.latitude_deg, global.longitude_deg};
-}
-
-gps_waypoint_t localToGlobal(const std::shared_ptr<mavsdk::geometry::CoordinateTransformation> &coord_transform, const local_waypoint_t &wl) {
-  gps_waypoint_t                                              wg;
-  mavsdk::geometry::CoordinateTransformation::LocalCoordinate local;
-  local.north_m = wl.y;
-  local.east_m  = wl.x;
-  auto global   = coord_transform->global_from_local(local);
-  wg.latitude   = global.latitude_deg;
-  wg.longitude  = global.longitude_deg;
-  wg.altitude   = wl.z;
-  wg.yaw        = wl.yaw;
+std::pair<double, double> localToGlobal(const std::shared_ptr<GeodeticTransform> &coord_transform, const double &x, const double &y) {
+  double latitude, longitude;
+  coord_transform->globalFromLocal(x, y, latitude, longitude);
+  return {latitude, longitude};
+}
+
+gps_waypoint_t localToGlobal(const std::shared_ptr<GeodeticTransform> &coord_transform, const local_waypoint_t &wl) {
+  gps_waypoint_t wg;
+  coord_transform->globalFromLocal(wl.x, wl.y, wg.latitude, wg.longitude);
+  wg.altitude = wl.z;
+  wg.yaw      = wl.yaw;
   return wg;
 }
 
-std::vector<gps_waypoint_t> localToGlobal(const std::shared_ptr<mavsdk::geometry::CoordinateTransformation> &coord_transform,
-                                          const std::vector<local_waypoint_t> &                              wls) {
-  std::vector<gps_waypoint_t> wgs;
-  for (const auto &wl : wls) {
-    wgs.push_back(localToGlobal(coord_transform, wl));
+std::vector<gps_waypoint_t> localToGlobal(const std::shared_ptr<GeodeticTransform> &coord_transform, const std::vector<local_waypoint_t> &wls) {
+  const size_t        n = wls.size();
+  std::vector<double> east(n), north(n), lat(n), lon(n);
+  for (size_t i = 0; i < n; i++) {
+    east[i]  = wls[i].x;
+    north[i] = wls[i].y;
+  }
+  coord_transform->globalFromLocal(east.data(), north.data(), lat.data(), lon.data(), n);
+
+  std::vector<gps_waypoint_t> wgs(n);
+  for (size_t i = 0; i < n; i++) {
+    wgs[i].latitude  = lat[i];
+    wgs[i].longitude = lon[i];
+    wgs[i].altitude  = wls[i].z;
+    wgs[i].yaw       = wls[i].yaw;
   }
   return wgs;
 }
@@ -151,400 +133,1199 @@ std::vector<gps_waypoint_t> localToGlobal(const std::shared_ptr<mavsdk::geometry
 
 //}
 
-/* class ControlInterface //{ */
-class ControlInterface : public rclcpp::Node {
-public:
-  ControlInterface(rclcpp::NodeOptions options);
+/* mission building //{ */
 
-private:
-  bool is_initialized_       = false;
-  bool getting_gps_          = false;
-  bool getting_pixhawk_odom_ = false;
-  bool getting_landed_info_  = false;
-  bool getting_control_mode_ = false;
-  bool start_mission_        = false;
-  bool armed_                = false;
-  bool takeoff_requested_    = false;
-  bool motion_started_       = false;
-  bool landed_               = true;
+/* planSegment //{ */
+// The speed after the item is limited by the length of the following leg, a vehicle which stops at both of its ends cannot go faster than
+// sqrt(a * length) on it. The vehicle flies through the waypoint unless the path turns back, and the faster it may take the corner, the larger
+// the acceptance radius, so that it starts turning early instead of braking at the waypoint.
+segment_plan_t planSegment(const local_waypoint_t &previous, const local_waypoint_t &current, const local_waypoint_t *next,
+                           const segment_limits_t &limits) {
+  segment_plan_t plan;
+  plan.speed             = limits.max_speed;
+  plan.acceptance_radius = limits.min_acceptance_radius;
+  plan.fly_through       = false;
 
-  bool     mission_finished_      = true;
-  unsigned last_mission_instance_ = 1;
+  // the vehicle stops at the last waypoint
+  if (next == nullptr) {
+    return plan;
+  }
 
-  std::string uav_name_         = "";
-  std::string world_frame_      = "";
-  std::string ned_origin_frame_ = "";
-  std::string ned_fcu_frame_    = "";
-  std::string fcu_frame_        = "";
+  const Eigen::Vector3d in(current.x - previous.x, current.y - previous.y, current.z - previous.z);
+  const Eigen::Vector3d out(next->x - current.x, next->y - current.y, next->z - current.z);
+  const bool            speed_limited = std::isfinite(limits.max_speed) && limits.max_speed > 0 && limits.max_acceleration > 0;
+  if (speed_limited) {
+    plan.speed = std::min(limits.max_speed, std::sqrt(limits.max_acceleration * out.norm()));
+  }
 
-  std::string                      device_url_;
-  mavsdk::Mavsdk                   mavsdk_;
-  std::shared_ptr<mavsdk::System>  system_;
-  std::shared_ptr<mavsdk::Action>  action_;
-  std::shared_ptr<mavsdk::Mission> mission_;
-  mavsdk::Mission::MissionPlan     mission_plan_;
+  // a leg of zero length does not turn
+  double turn = 0.0;
+  if (in.norm() > 1e-6 && out.norm() > 1e-6) {
+    turn = std::acos(std::clamp(in.dot(out) / (in.norm() * out.norm()), -1.0, 1.0));
+  }
+  if (turn > limits.max_fly_through_turn) {
+    return plan;
+  }
 
-  std::deque<local_waypoint_t> waypoint_buffer_;
-  Eigen::Vector4d              desired_pose_;
+  plan.fly_through = true;
+  if (speed_limited) {
+    const double corner_speed = limits.max_speed * (1.0 + std::cos(turn)) / 2.0;
+    plan.acceptance_radius =
+        std::clamp(corner_speed * corner_speed / (2.0 * limits.max_acceleration), limits.min_acceptance_radius, limits.max_acceptance_radius);
+  }
+  return plan;
+}
+//}
 
-  std::shared_ptr<tf2_ros::Buffer>                     tf_buffer_;
-  std::shared_ptr<tf2_ros::TransformListener>          tf_listener_;
-  std::shared_ptr<tf2_ros::TransformBroadcaster>       tf_broadcaster_;
-  std::shared_ptr<tf2_ros::StaticTransformBroadcaster> static_tf_broadcaster_;
+/* simplifyPath //{ */
+namespace
+{
+// spans are cut to this many waypoints before the simplification, so that its cost stays linear in the length of the path
+constexpr size_t simplify_max_span = 256;
+// a cut is dropped afterwards only if the segment which replaces it spans at most this many waypoints, for the same reason
+constexpr size_t simplify_max_merge = 4 * simplify_max_span;
+
+// deviation of w from the segment a-b relative to the tolerances, the vehicle flies the segment with the yaw of b
+double simplificationError(const local_waypoint_t &w, const local_waypoint_t &a, const local_waypoint_t &b, const double position_tolerance,
+                           const double yaw_tolerance) {
+  const Eigen::Vector3d p(w.x - a.x, w.y - a.y, w.z - a.z);
+  const Eigen::Vector3d s(b.x - a.x, b.y - a.y, b.z - a.z);
+  const double          length2 = s.squaredNorm();
+  const double          t       = length2 > 0.0 ? std::clamp(p.dot(s) / length2, 0.0, 1.0) : 0.0;
+  const double          yaw     = std::abs(std::remainder(w.yaw - b.yaw, 2 * M_PI));
+  if (yaw_tolerance <= 0.0 && yaw > 0.0) {
+    return std::numeric_limits<double>::infinity();
+  }
+  return std::max((p - t * s).norm() / position_tolerance, yaw_tolerance > 0.0 ? yaw / yaw_tolerance : 0.0);
+}
+}  // namespace
+
+// Ramer-Douglas-Peucker: a span keeps the waypoint which deviates the most from the straight line between its ends and is split there,
+// until every dropped waypoint is within the tolerances of the segment which replaces it. Returns the number of dropped waypoints.
+size_t simplifyPath(std::vector<local_waypoint_t> &wls, const double position_tolerance, const double yaw_tolerance) {
+  if (wls.size() < 3 || position_tolerance <= 0.0) {
+    return 0;
+  }
+
+  std::vector<bool>                      keep(wls.size(), false);
+  std::vector<std::pair<size_t, size_t>> spans;
+  for (size_t first = 0; first + 1 < wls.size(); first += simplify_max_span) {
+    const size_t last = std::min(first + simplify_max_span, wls.size() - 1);
+    keep[first]       = true;
+    keep[last]        = true;
+    spans.emplace_back(first, last);
+  }
+
+  while (!spans.empty()) {
+    const auto [first, last] = spans.back();
+    spans.pop_back();
+    double worst = 1.0;
+    size_t split = first;
+    for (size_t i = first + 1; i < last; i++) {
+      const double error = simplificationError(wls[i], wls[first], wls[last], position_tolerance, yaw_tolerance);
+      if (error > worst) {
+        worst = error;
+        split = i;
+      }
+    }
+    if (split != first) {
+      keep[split] = true;
+      spans.emplace_back(first, split);
+      spans.emplace_back(split, last);
+    }
+  }
 
-  // vehicle global position
-  float latitude_, longitude_, altitude_;
+  // the cuts between the spans are kept regardless of the geometry, drop those which the waypoints around them do not need
+  size_t previous = 0;  // the last kept waypoint before the cut
+  for (size_t cut = simplify_max_span; cut + 1 < wls.size(); cut += simplify_max_span) {
+    for (size_t i = previous + 1; i < cut; i++) {
+      if (keep[i]) {
+        previous = i;
+      }
+    }
+    size_t next = cut + 1;
+    while (!keep[next]) {
+      next++;
+    }
+    bool needed = next - previous > simplify_max_merge;
+    for (size_t i = previous + 1; i < next && !needed; i++) {
+      needed = simplificationError(wls[i], wls[previous], wls[next], position_tolerance, yaw_tolerance) > 1.0;
+    }
+    if (needed) {
+      previous = cut;
+    } else {
+      keep[cut] = false;
+    }
+  }
 
-  // vehicle local position
-  float pos_[3];
-  float ori_[4];
+  size_t kept = 0;
+  for (size_t i = 0; i < wls.size(); i++) {
+    if (keep[i]) {
+      wls[kept++] = wls[i];
+    }
+  }
+  const size_t dropped = wls.size() - kept;
+  wls.resize(kept);
+  return dropped;
+}
+//}
 
-  // use takeoff lat and long to initialize local frame
-  std::shared_ptr<mavsdk::geometry::CoordinateTransformation> coord_transform_;
+//}
 
-  // config params
-  double yaw_offset_correction_        = M_PI / 2;
-  double takeoff_height_               = 2.5;
-  double waypoint_marker_scale_        = 0.3;
-  double control_update_rate_          = 10.0;
-  double waypoint_loiter_time_         = 0.0;
-  bool   reset_octomap_before_takeoff_ = true;
-  double waypoint_acceptance_radius_   = 0.3;
-  double target_velocity_              = 1.0;
+/* missionItemHash //{ */
+// FNV-1a over the fields which PX4 receives, two items with the same hash are treated as the same mission item
+size_t missionItemHash(const mavsdk::Mission::MissionItem &item) {
+  uint64_t   hash = 14695981039346656037ull;
+  const auto add  = [&hash](const void *data, const size_t size) {
+    const auto *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < size; i++) {
+      hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+  };
+  add(&item.latitude_deg, sizeof(item.latitude_deg));
+  add(&item.longitude_deg, sizeof(item.longitude_deg));
+  add(&item.relative_altitude_m, sizeof(item.relative_altitude_m));
+  add(&item.speed_m_s, sizeof(item.speed_m_s));
+  add(&item.is_fly_through, sizeof(item.is_fly_through));
+  add(&item.gimbal_pitch_deg, sizeof(item.gimbal_pitch_deg));
+  add(&item.gimbal_yaw_deg, sizeof(item.gimbal_yaw_deg));
+  add(&item.camera_action, sizeof(item.camera_action));
+  add(&item.loiter_time_s, sizeof(item.loiter_time_s));
+  add(&item.camera_photo_interval_s, sizeof(item.camera_photo_interval_s));
+  add(&item.acceptance_radius_m, sizeof(item.acceptance_radius_m));
+  add(&item.yaw_deg, sizeof(item.yaw_deg));
+  return size_t(hash);
+}
+//}
 
-  // publishers
-  rclcpp::Publisher<px4_msgs::msg::VehicleCommand>::SharedPtr   vehicle_command_publisher_;
-  rclcpp::Publisher<nav_msgs::msg::Odometry>::SharedPtr         local_odom_publisher_;
-  rclcpp::Publisher<geometry_msgs::msg::PoseStamped>::SharedPtr desired_pose_publisher_;  // https://ctu-mrs.github.io/docs/system/relative_commands.html
-  rclcpp::Publisher<geometry_msgs::msg::PoseArray>::SharedPtr   waypoint_marker_publisher_;
-  rclcpp::Publisher<fog_msgs::msg::ControlInterfaceDiagnostics>::SharedPtr diagnostics_publisher_;
+/* mavlinkItemCount //{ */
+// MAVSDK 0.42 uploads every mission item as several MAVLink items, and PX4 reports the progress in their sequence numbers. An item of this
+// node becomes a NAV_WAYPOINT, followed by DO_CHANGE_SPEED if the speed is set and NAV_LOITER_TIME if the loiter time is positive. The gimbal
+// and camera fields are left unset, their items would depend on the gimbal protocol which MAVSDK detects at runtime.
+int mavlinkItemCount(const mavsdk::Mission::MissionItem &item) {
+  int count = 1;
+  if (std::isfinite(item.speed_m_s)) {
+    count++;
+  }
+  if (std::isfinite(item.loiter_time_s) && item.loiter_time_s > 0.0f) {
+    count++;
+  }
+  return count;
+}
 
-  // subscribers
-  rclcpp::Subscription<px4_msgs::msg::VehicleGlobalPosition>::SharedPtr gps_subscriber_;
-  rclcpp::Subscription<px4_msgs::msg::VehicleOdometry>::SharedPtr       pixhawk_odom_subscriber_;
-  rclcpp::Subscription<px4_msgs::msg::VehicleControlMode>::SharedPtr    control_mode_subscriber_;
-  rclcpp::Subscription<px4_msgs::msg::VehicleLandDetected>::SharedPtr   land_detected_subscriber_;
-  rclcpp::Subscription<px4_msgs::msg::MissionResult>::SharedPtr         mission_result_subscriber_;
-
-  // subscriber callbacks
-  void gpsCallback(const px4_msgs::msg::VehicleGlobalPosition::UniquePtr msg);
-  void pixhawkOdomCallback(const px4_msgs::msg::VehicleOdometry::UniquePtr msg);
-  void controlModeCallback(const px4_msgs::msg::VehicleControlMode::UniquePtr msg);
-  void landDetectedCallback(const px4_msgs::msg::VehicleLandDetected::UniquePtr msg);
-  void missionResultCallback(const px4_msgs::msg::MissionResult::UniquePtr msg);
-
-  // services provided
-  rclcpp::Service<std_srvs::srv::SetBool>::SharedPtr         arming_service_;
-  rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr         takeoff_service_;
-  rclcpp::Service<std_srvs::srv::Trigger>::SharedPtr         land_service_;
-  rclcpp::Service<fog_msgs::srv::Vec4>::SharedPtr            local_waypoint_service_;
-  rclcpp::Service<fog_msgs::srv::Path>::SharedPtr            local_path_service_;
-  rclcpp::Service<fog_msgs::srv::Vec4>::SharedPtr            gps_waypoint_service_;
-  rclcpp::Service<fog_msgs::srv::Path>::SharedPtr            gps_path_service_;
-  rclcpp::Service<fog_msgs::srv::WaypointToLocal>::SharedPtr waypoint_to_local_service_;
-  rclcpp::Service<fog_msgs::srv::PathToLocal>::SharedPtr     path_to_local_service_;
-
-  rclcpp::Client<std_srvs::srv::Empty>::SharedPtr octomap_reset_client_;
-
-  // service callbacks
-  bool armingCallback(const std::shared_ptr<std_srvs::srv::SetBool::Request> request, std::shared_ptr<std_srvs::srv::SetBool::Response> response);
-  bool takeoffCallback(const std::shared_ptr<std_srvs::srv::Trigger::Request> request, std::shared_ptr<std_srvs::srv::Trigger::Response> response);
-  bool landCallback(const std::shared_ptr<std_srvs::srv::Trigger::Request> request, std::shared_ptr<std_srvs::srv::Trigger::Response> response);
-  bool localWaypointCallback(const std::shared_ptr<fog_msgs::srv::Vec4::Request> request, std::shared_ptr<fog_msgs::srv::Vec4::Response> response);
-  bool localPathCallback(const std::shared_ptr<fog_msgs::srv::Path::Request> request, std::shared_ptr<fog_msgs::srv::Path::Response> response);
-  bool gpsWaypointCallback(const std::shared_ptr<fog_msgs::srv::Vec4::Request> request, std::shared_ptr<fog_msgs::srv::Vec4::Response> response);
-  bool gpsPathCallback(const std::shared_ptr<fog_msgs::srv::Path::Request> request, std::shared_ptr<fog_msgs::srv::Path::Response> response);
-  bool waypointToLocalCallback(const std::shared_ptr<fog_msgs::srv::WaypointToLocal::Request> request,
-                               std::shared_ptr<fog_msgs::srv::WaypointToLocal::Response>      response);
-  bool pathToLocalCallback(const std::shared_ptr<fog_msgs::srv::PathToLocal::Request> request, std::shared_ptr<fog_msgs::srv::PathToLocal::Response> response);
-
-  bool gettingPixhawkSensors();
-  void printSensorsStatus();
-  void publishDiagnostics();
-
-  bool takeoff();
-  bool land();
-  bool startMission();
-  bool uploadMission();
-  bool stopPreviousMission();
-
-  void addToMission(local_waypoint_t w);
-  void publishTF();
-  void publishStaticTF();
-  void publishLocalOdom();
-  void publishDebugMarkers();
-  void publishDesiredPose();
-
-  geometry_msgs::msg::PoseStamped transformBetween(std::string frame_from, std::string frame_to);
-  std_msgs::msg::ColorRGBA        generateColor(const double r, const double g, const double b, const double a);
-
-  // timers
-  rclcpp::CallbackGroup::SharedPtr callback_group_;
-  rclcpp::TimerBase::SharedPtr     control_timer_;
-  void                             controlRoutine(void);
-
-  // utils
-  template <class T>
-  bool parse_param(std::string param_name, T &param_dest);
-};
+// index of the item which the MAVLink item seq_reached belongs to, first_seq holds the seq of the first MAVLink item of every item
+int missionItemReached(const std::vector<int> &first_seq, const int seq_reached) {
+  return int(std::upper_bound(first_seq.begin(), first_seq.end(), seq_reached) - first_seq.begin()) - 1;
+}
+//}
+
+/* qosProfile //{ */
+bool isQosProfile(const std::string &profile) {
+  return profile == "sensor_data" || profile == "reliable";
+}
+
+// only keep last profiles, intra-process communication rejects the others
+rclcpp::QoS qosProfile(const std::string &profile) {
+  if (profile == "sensor_data") {
+    return rclcpp::SensorDataQoS();
+  }
+  return rclcpp::QoS(rclcpp::KeepLast(3)).reliable();
+}
 //}
 
+/* class CommandWorker //{ */
 /* constructor //{ */
-ControlInterface::ControlInterface(rclcpp::NodeOptions options) : Node("control_interface", options) {
+CommandWorker::CommandWorker(rclcpp::Logger logger, double timeout, std::shared_ptr<FlightRecorder> recorder)
+    : logger_(logger), timeout_(timeout), recorder_(recorder) {
+  thread_ = std::thread(&CommandWorker::run, this);
+}
+//}
 
-  RCLCPP_INFO(this->get_logger(), "Initializing...");
+/* destructor //{ */
+CommandWorker::~CommandWorker() {
+  {
+    std::scoped_lock lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  thread_.join();
+}
+//}
 
-  try {
-    uav_name_ = std::string(std::getenv("DRONE_DEVICE_ID"));
+/* addLane //{ */
+size_t CommandWorker::addLane(const std::string &vehicle_name, const uint16_t system_id) {
+  std::scoped_lock lock(mutex_);
+  lanes_.emplace_back();
+  lanes_.back().vehicle_name = vehicle_name;
+  lanes_.back().system_id    = system_id;
+  return lanes_.size() - 1;
+}
+//}
+
+/* enqueue //{ */
+std::future<CommandWorker::result_t> CommandWorker::enqueue(const size_t lane, const std::string &name, const flight_record_t::command_t code,
+                                                            std::shared_ptr<LatencyHistogram> latency, std::function<void(DoneCallback)> execute) {
+  command_t command;
+  command.name    = name;
+  command.code    = code;
+  command.execute = std::move(execute);
+  command.latency = std::move(latency);
+  auto future     = command.promise.get_future();
+  {
+    std::scoped_lock lock(mutex_);
+    if (stop_) {
+      command.promise.set_value({false, "Command worker stopped"});
+      return future;
+    }
+    lanes_[lane].queue.push_back(std::move(command));
   }
-  catch (...) {
-    RCLCPP_ERROR(this->get_logger(), "[%s]: Environment variable DRONE_DEVICE_ID was not defined!", this->get_name());
+  cv_.notify_all();
+  return future;
+}
+//}
+
+/* run //{ */
+void CommandWorker::run() {
+  std::unique_lock lock(mutex_);
+  while (!stop_) {
+    const auto now           = std::chrono::steady_clock::now();
+    auto       next_deadline = std::chrono::steady_clock::time_point::max();
+    bool       started       = false;
+
+    for (size_t i = 0; i < lanes_.size(); i++) {
+      lane_t &lane = lanes_[i];
+
+      // the acknowledgement may arrive after the timeout, only the first outcome is used
+      if (lane.in_flight && lane.ack) {
+        finish(lane, *lane.ack);
+      } else if (lane.in_flight && now >= lane.deadline) {
+        finish(lane, {false, "Timeout"});
+      }
+
+      if (!lane.in_flight && lane.queue.size() > 0) {
+        lane.current = std::move(lane.queue.front());
+        lane.queue.pop_front();
+        lane.in_flight = true;
+        lane.started   = now;
+        lane.deadline  = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout_);
+
+        // MAVSDK may acknowledge from within the call, do not hold the lock while issuing the command
+        const uint64_t generation = lane.generation;
+        lock.unlock();
+        lane.current.execute([this, &lane, generation](result_t result) {
+          std::scoped_lock ack_lock(mutex_);
+          if (lane.in_flight && lane.generation == generation && !lane.ack) {
+            lane.ack = std::move(result);
+            cv_.notify_all();
+          }
+        });
+        lock.lock();
+        started = true;
+      }
+
+      if (lane.in_flight) {
+        next_deadline = std::min(next_deadline, lane.deadline);
+      }
+    }
+
+    // a command may have been acknowledged while the lock was released, scan the lanes again before sleeping
+    if (started || stop_) {
+      continue;
+    }
+    if (next_deadline == std::chrono::steady_clock::time_point::max()) {
+      cv_.wait(lock);
+    } else {
+      cv_.wait_until(lock, next_deadline);
+    }
+  }
+
+  for (auto &lane : lanes_) {
+    if (lane.in_flight) {
+      lane.current.promise.set_value({false, "Command worker stopped"});
+    }
+    for (auto &c : lane.queue) {
+      c.promise.set_value({false, "Command worker stopped"});
+    }
+    lane.queue.clear();
+  }
+}
+//}
+
+/* finish //{ */
+void CommandWorker::finish(lane_t &lane, const result_t &result) {
+  if (result.success) {
+    RCLCPP_INFO(logger_, "[%s]: %s: %s", lane.vehicle_name.c_str(), lane.current.name.c_str(), result.message.c_str());
+  } else {
+    RCLCPP_ERROR(logger_, "[%s]: %s failed: %s", lane.vehicle_name.c_str(), lane.current.name.c_str(), result.message.c_str());
+  }
+  const auto duration = std::chrono::steady_clock::now() - lane.started;
+  if (lane.current.latency != nullptr) {
+    lane.current.latency->record(duration);
   }
-  RCLCPP_INFO(this->get_logger(), "[%s]: UAV name is: '%s'", this->get_name(), uav_name_.c_str());
+  if (recorder_ != nullptr) {
+    recorder_->record(flight_record_t::command_result, lane.system_id, lane.current.code,
+                      {std::chrono::duration<double>(duration).count(), result.success ? 1.0 : 0.0});
+  }
+  lane.current.promise.set_value(result);
+  lane.in_flight = false;
+  lane.ack.reset();
+  lane.generation++;
+}
+//}
+
+/* toResult //{ */
+template <class ResultT>
+CommandWorker::result_t CommandWorker::toResult(const ResultT result, const ResultT success) {
+  std::stringstream ss;
+  ss << result;
+  return {result == success, ss.str()};
+}
+//}
+
+//}
+
+/* class CommandChannel //{ */
+/* constructor //{ */
+CommandChannel::CommandChannel(std::shared_ptr<CommandWorker> worker, std::shared_ptr<mavsdk::System> system, const std::string &vehicle_name,
+                               std::shared_ptr<latency_stats_t> latency, const float takeoff_altitude)
+    : worker_(worker), latency_(latency), takeoff_altitude_(takeoff_altitude) {
+  lane_    = worker_->addLane(vehicle_name, system->get_system_id());
+  action_  = std::make_shared<mavsdk::Action>(system);
+  mission_ = std::make_shared<mavsdk::Mission>(system);
+  setTakeoffAltitude();
+}
+//}
+
+/* setTakeoffAltitude //{ */
+// the parameter handshake can take up to the MAVSDK timeout on a bad link, it must not hold up the commands of the other vehicles
+void CommandChannel::setTakeoffAltitude() {
+  takeoff_altitude_set_ = std::async(std::launch::async, [action = action_, altitude = takeoff_altitude_]() {
+    return CommandWorker::toResult(action->set_takeoff_altitude(altitude), mavsdk::Action::Result::Success);
+  }).share();
+}
+//}
+
+/* histogram //{ */
+std::shared_ptr<LatencyHistogram> CommandChannel::histogram(const latency_stats_t::id_t id) {
+  return std::shared_ptr<LatencyHistogram>(latency_, &latency_->histograms[id]);
+}
+//}
+
+/* commands //{ */
+std::future<CommandChannel::result_t> CommandChannel::arm() {
+  return worker_->enqueue(lane_, "Arming", flight_record_t::arm, histogram(latency_stats_t::mavsdk_arming), [action = action_](DoneCallback done) {
+    action->arm_async([done](mavsdk::Action::Result r) { done(CommandWorker::toResult(r, mavsdk::Action::Result::Success)); });
+  });
+}
+
+std::future<CommandChannel::result_t> CommandChannel::disarm() {
+  return worker_->enqueue(lane_, "Disarming", flight_record_t::disarm, histogram(latency_stats_t::mavsdk_arming), [action = action_](DoneCallback done) {
+    action->disarm_async([done](mavsdk::Action::Result r) { done(CommandWorker::toResult(r, mavsdk::Action::Result::Success)); });
+  });
+}
+
+std::future<CommandChannel::result_t> CommandChannel::takeoff() {
+  const result_t altitude = takeoff_altitude_set_.get();
+  if (!altitude.success) {
+    // tried again for the next takeoff, this one fails right away
+    setTakeoffAltitude();
+    std::promise<result_t> failed;
+    failed.set_value({false, "Setting the takeoff altitude failed: " + altitude.message});
+    return failed.get_future();
+  }
+  return worker_->enqueue(lane_, "Takeoff", flight_record_t::takeoff, histogram(latency_stats_t::mavsdk_takeoff), [action = action_](DoneCallback done) {
+    action->takeoff_async([done](mavsdk::Action::Result r) { done(CommandWorker::toResult(r, mavsdk::Action::Result::Success)); });
+  });
+}
+
+std::future<CommandChannel::result_t> CommandChannel::land() {
+  return worker_->enqueue(lane_, "Landing", flight_record_t::land, histogram(latency_stats_t::mavsdk_land), [action = action_](DoneCallback done) {
+    action->land_async([done](mavsdk::Action::Result r) { done(CommandWorker::toResult(r, mavsdk::Action::Result::Success)); });
+  });
+}
+
+std::future<CommandChannel::result_t> CommandChannel::uploadMission(const mavsdk::Mission::MissionPlan &mission_plan) {
+  return worker_->enqueue(lane_, "Mission upload", flight_record_t::upload_mission, histogram(latency_stats_t::mission_upload), [mission = mission_, mission_plan](DoneCallback done) {
+    mission->upload_mission_async(mission_plan, [done](mavsdk::Mission::Result r) { done(CommandWorker::toResult(r, mavsdk::Mission::Result::Success)); });
+  });
+}
+
+std::future<CommandChannel::result_t> CommandChannel::startMission() {
+  return worker_->enqueue(lane_, "Mission start", flight_record_t::start_mission, histogram(latency_stats_t::mission_start), [mission = mission_](DoneCallback done) {
+    mission->start_mission_async([done](mavsdk::Mission::Result r) { done(CommandWorker::toResult(r, mavsdk::Mission::Result::Success)); });
+  });
+}
+
+std::future<CommandChannel::result_t> CommandChannel::pauseMission() {
+  return worker_->enqueue(lane_, "Mission pause", flight_record_t::pause_mission, histogram(latency_stats_t::mission_pause), [mission = mission_](DoneCallback done) {
+    mission->pause_mission_async([done](mavsdk::Mission::Result r) { done(CommandWorker::toResult(r, mavsdk::Mission::Result::Success)); });
+  });
+}
+
+std::future<CommandChannel::result_t> CommandChannel::setCurrentMissionItem(int index) {
+  return worker_->enqueue(lane_, "Mission set current item", flight_record_t::set_current_mission_item, histogram(latency_stats_t::mission_start), [mission = mission_, index](DoneCallback done) {
+    mission->set_current_mission_item_async(index,
+                                            [done](mavsdk::Mission::Result r) { done(CommandWorker::toResult(r, mavsdk::Mission::Result::Success)); });
+  });
+}
+//}
+
+//}
+
+
+/* constructor //{ */
+ControlInterface::ControlInterface(rclcpp::NodeOptions options) : Node("control_interface", options) {
+
+  RCLCPP_INFO(this->get_logger(), "Initializing...");
 
   /* parse params from config file //{ */
+  vehicle_params_t params;
+  int              system_id = 1;
   parse_param("device_url", device_url_);
-  parse_param("yaw_offset_correction", yaw_offset_correction_);
-  parse_param("takeoff_height", takeoff_height_);
-  parse_param("waypoint_marker_scale", waypoint_marker_scale_);
-  parse_param("waypoint_loiter_time", waypoint_loiter_time_);
-  parse_param("reset_octomap_before_takeoff", reset_octomap_before_takeoff_);
-  parse_param("waypoint_acceptance_radius", waypoint_acceptance_radius_);
-  parse_param("target_velocity", target_velocity_);
-  parse_param("control_update_rate", control_update_rate_);
-
-  if (control_update_rate_ < 5.0) {
-    control_update_rate_ = 5.0;
+  parse_param("system_id", system_id);
+  parse_param("yaw_offset_correction", params.yaw_offset_correction);
+  parse_param("takeoff_height", params.takeoff_height);
+  parse_param("waypoint_marker_scale", params.waypoint_marker_scale);
+  parse_param("waypoint_loiter_time", params.waypoint_loiter_time);
+  parse_param("reset_octomap_before_takeoff", params.reset_octomap_before_takeoff);
+  parse_param("waypoint_acceptance_radius", params.waypoint_acceptance_radius);
+  parse_param("target_velocity", params.target_velocity);
+  parse_param("control_update_rate", params.control_update_rate);
+  parse_param("command_timeout", params.command_timeout);
+  parse_param("verify_local_odom_with_tf", params.verify_local_odom_with_tf);
+  parse_param("mission_window_size", params.mission_window_size);
+  parse_param("mission_refill_threshold", params.mission_refill_threshold);
+  parse_param("stream_position_tolerance", params.stream_position_tolerance);
+  parse_param("stream_yaw_tolerance", params.stream_yaw_tolerance);
+  parse_param("offboard_control", params.offboard_control);
+  parse_param("offboard_setpoint_rate", params.offboard_setpoint_rate);
+  parse_param("latency_export_period", params.latency_export_period);
+  parse_param("diagnostics_heartbeat_period", params.diagnostics_heartbeat_period);
+  parse_param("flight_recorder_path", params.flight_recorder_path);
+  parse_param("flight_recorder_records", params.flight_recorder_records);
+  parse_param("flight_recorder_odometry_rate", params.flight_recorder_odometry_rate);
+  parse_param("gps_timeout", params.gps_timeout);
+  parse_param("odometry_timeout", params.odometry_timeout);
+  parse_param("control_mode_timeout", params.control_mode_timeout);
+  parse_param("land_detected_timeout", params.land_detected_timeout);
+  parse_param("waypoint_buffer_capacity", params.waypoint_buffer_capacity);
+  parse_param("max_acceleration", params.max_acceleration);
+  parse_param("max_acceptance_radius", params.max_acceptance_radius);
+  parse_param("max_fly_through_turn", params.max_fly_through_turn);
+  parse_param("simplify_tolerance_ratio", params.simplify_tolerance_ratio);
+  parse_param("simplify_yaw_tolerance", params.simplify_yaw_tolerance);
+  for (auto &[topic, profile] : params.qos) {
+    parse_param("qos." + topic, profile);
+  }
+
+  // optional, an empty list means a single vehicle named by DRONE_DEVICE_ID
+  const auto fleet            = this->declare_parameter<std::vector<std::string>>("param_namespace.fleet", std::vector<std::string>());
+  const auto fleet_system_ids = this->declare_parameter<std::vector<int64_t>>("param_namespace.fleet_system_ids", std::vector<int64_t>());
+
+  if (params.control_update_rate < 5.0) {
+    params.control_update_rate = 5.0;
     RCLCPP_WARN(this->get_logger(), "[%s]: Control update rate set too slow. Defaulting to 5 Hz", this->get_name());
   }
 
-  /* frame definition */
-  world_frame_      = "world";
-  fcu_frame_        = uav_name_ + "/fcu";
-  ned_fcu_frame_    = uav_name_ + "/ned_fcu";
-  ned_origin_frame_ = uav_name_ + "/ned_origin";
+  if (params.offboard_control && params.offboard_setpoint_rate < 2.0) {
+    params.offboard_setpoint_rate = 2.0;
+    RCLCPP_WARN(this->get_logger(), "[%s]: Offboard setpoint rate set too slow, PX4 would leave offboard mode. Defaulting to 2 Hz", this->get_name());
+  }
+
+  if (params.mission_window_size < 1) {
+    params.mission_window_size = 1;
+    RCLCPP_WARN(this->get_logger(), "[%s]: Mission window size must be positive. Defaulting to 1 waypoint", this->get_name());
+  }
+
+  if (params.max_acceptance_radius < params.waypoint_acceptance_radius) {
+    params.max_acceptance_radius = params.waypoint_acceptance_radius;
+    RCLCPP_WARN(this->get_logger(), "[%s]: Max acceptance radius below the waypoint acceptance radius. Defaulting to %.2f m", this->get_name(),
+                params.max_acceptance_radius);
+  }
+
+  if (params.waypoint_buffer_capacity < 1) {
+    params.waypoint_buffer_capacity = 1;
+    RCLCPP_WARN(this->get_logger(), "[%s]: Waypoint buffer capacity must be positive. Defaulting to 1 waypoint", this->get_name());
+  }
+
+  if (params.flight_recorder_records < 2) {
+    params.flight_recorder_records = vehicle_params_t().flight_recorder_records;
+    RCLCPP_WARN(this->get_logger(), "[%s]: Flight recorder needs at least 2 records. Defaulting to %d records", this->get_name(), params.flight_recorder_records);
+  }
+
+  if (params.mission_refill_threshold < 0 || params.mission_refill_threshold >= params.mission_window_size) {
+    params.mission_refill_threshold = params.mission_window_size / 2;
+    RCLCPP_WARN(this->get_logger(), "[%s]: Mission refill threshold out of range. Defaulting to %d waypoints", this->get_name(),
+                params.mission_refill_threshold);
+  }
+
+  const vehicle_params_t defaults;
+  for (auto &[topic, profile] : params.qos) {
+    if (!isQosProfile(profile)) {
+      RCLCPP_WARN(this->get_logger(), "[%s]: Unknown QoS profile '%s' of topic '%s'. Defaulting to '%s'", this->get_name(), profile.c_str(),
+                  topic.c_str(), defaults.qos.at(topic).c_str());
+      profile = defaults.qos.at(topic);
+    }
+  }
+
+  if (fleet.size() != fleet_system_ids.size()) {
+    RCLCPP_ERROR(this->get_logger(), "[%s]: Parameters 'fleet' and 'fleet_system_ids' must have the same length, no vehicle will be controlled",
+                 this->get_name());
+    return;
+  }
+  //}
+
+  if (!params.flight_recorder_path.empty()) {
+    std::string error;
+    recorder_ = FlightRecorder::create(params.flight_recorder_path, params.flight_recorder_records, 8192, std::chrono::milliseconds(100), error);
+    if (recorder_ == nullptr) {
+      RCLCPP_ERROR(this->get_logger(), "[%s]: Flight recorder disabled, %s", this->get_name(), error.c_str());
+    } else {
+      RCLCPP_INFO(this->get_logger(), "[%s]: Recording flight data into %s", this->get_name(), recorder_->path().c_str());
+    }
+  }
+
+  command_worker_ = std::make_shared<CommandWorker>(this->get_logger(), params.command_timeout, recorder_);
+
+  // the tf2 buffer is needed only to verify the computed local odometry, one listener serves all vehicles
+  if (params.verify_local_odom_with_tf) {
+    tf_buffer_ = std::make_shared<tf2_ros::Buffer>(this->get_clock());
+    tf_buffer_->setUsingDedicatedThread(true);
+    tf_listener_ = std::make_shared<tf2_ros::TransformListener>(*tf_buffer_, this, false);
+  }
+
+  /* create vehicles //{ */
+  if (fleet.empty()) {
+    std::string uav_name;
+    try {
+      uav_name = std::string(std::getenv("DRONE_DEVICE_ID"));
+    }
+    catch (...) {
+      RCLCPP_ERROR(this->get_logger(), "[%s]: Environment variable DRONE_DEVICE_ID was not defined!", this->get_name());
+    }
+    RCLCPP_INFO(this->get_logger(), "[%s]: UAV name is: '%s'", this->get_name(), uav_name.c_str());
+    vehicles_.emplace_back(*this, mavsdk_, command_worker_, tf_buffer_, recorder_, params, this->get_name(), uav_name, system_id, "~/");
+  } else {
+    for (size_t i = 0; i < fleet.size(); i++) {
+      RCLCPP_INFO(this->get_logger(), "[%s]: Fleet vehicle '%s' with system ID %ld", this->get_name(), fleet[i].c_str(), fleet_system_ids[i]);
+      vehicles_.emplace_back(*this, mavsdk_, command_worker_, tf_buffer_, recorder_, params, fleet[i], fleet[i], fleet_system_ids[i],
+                             "~/" + fleet[i] + "/");
+    }
+  }
   //}
 
   /* estabilish connection with PX4 //{ */
+  // all vehicles share one MAVSDK instance, each of them picks its own system once it is discovered
+  mavsdk_.subscribe_on_new_system([this]() {
+    for (auto &vehicle : vehicles_) {
+      vehicle.newSystemDiscovered();
+    }
+  });
+  // the interceptors only count the traffic of each vehicle for its link diagnostics, no message is dropped
+  mavsdk_.intercept_incoming_messages_async([this](mavlink_message_t &message) {
+    for (auto &vehicle : vehicles_) {
+      vehicle.messageReceived(message.sysid, message.compid, message.seq);
+    }
+    return true;
+  });
+  mavsdk_.intercept_outgoing_messages_async([this](mavlink_message_t &message) {
+    // the target system is a field of the payload, its offset is in the message table
+    const mavlink_msg_entry_t *entry = mavlink_get_msg_entry(message.msgid);
+    if (entry == nullptr || !(entry->flags & MAV_MSG_ENTRY_FLAG_HAVE_TARGET_SYSTEM)) {
+      return true;
+    }
+    const int target_system = _MAV_PAYLOAD(&message)[entry->target_system_ofs];
+    // MAVSDK increments the confirmation field of COMMAND_LONG with every retransmission
+    const bool retransmission = message.msgid == MAVLINK_MSG_ID_COMMAND_LONG && mavlink_msg_command_long_get_confirmation(&message) > 0;
+    for (auto &vehicle : vehicles_) {
+      vehicle.messageSent(target_system, message.msgid, retransmission);
+    }
+    return true;
+  });
+  if (!connectDevice()) {
+    connection_timer_ = this->create_wall_timer(std::chrono::seconds(1), [this]() {
+      if (connectDevice()) {
+        connection_timer_->cancel();
+      }
+    });
+  }
+  //}
+
+  RCLCPP_INFO(this->get_logger(), "[%s]: Initialized %lu vehicle(s)", this->get_name(), vehicles_.size());
+}
+//}
+
+/* destructor //{ */
+ControlInterface::~ControlInterface() {
+  mavsdk_.subscribe_on_new_system(nullptr);
+  mavsdk_.intercept_incoming_messages_async(nullptr);
+  mavsdk_.intercept_outgoing_messages_async(nullptr);
+}
+//}
+
+/* connectDevice //{ */
+bool ControlInterface::connectDevice() {
   mavsdk::ConnectionResult connection_result;
   try {
     connection_result = mavsdk_.add_any_connection(device_url_);
   }
   catch (...) {
     RCLCPP_ERROR(this->get_logger(), "[%s]: Connection failed! Device does not exist: %s", this->get_name(), device_url_.c_str());
-    exit(EXIT_FAILURE);
+    return false;
   }
   if (connection_result != mavsdk::ConnectionResult::Success) {
-    RCLCPP_ERROR(this->get_logger(), "[%s]: Connection failed: %s", this->get_name(), connection_result);
-    exit(EXIT_FAILURE);
-  } else {
-    RCLCPP_INFO(this->get_logger(), "[%s]: MAVSDK connected to device: %s", this->get_name(), device_url_.c_str());
+    RCLCPP_ERROR_STREAM(this->get_logger(), "[" << this->get_name() << "]: Connection failed: " << connection_result);
+    return false;
   }
 
-  bool connected = false;
-  while (rclcpp::ok() && !connected) {
-    RCLCPP_INFO(this->get_logger(), "[%s]: Systems size: %ld", this->get_name(), mavsdk_.systems().size());
-    if (mavsdk_.systems().size() < 1) {
-      RCLCPP_INFO(this->get_logger(), "[%s]: Waiting for connection at URL: %s", this->get_name(), device_url_.c_str());
-      rclcpp::sleep_for(std::chrono::seconds(1));
-    }
-    for (unsigned i = 0; i < mavsdk_.systems().size(); i++) {
-      if (mavsdk_.systems().at(i)->get_system_id() == 1) {
-        RCLCPP_INFO(this->get_logger(), "[%s]: ID: %u", this->get_name(), mavsdk_.systems().at(i)->get_system_id());
-        connected = true;
-        system_   = mavsdk_.systems().at(i);
-        break;
-      }
-    }
+  RCLCPP_INFO(this->get_logger(), "[%s]: MAVSDK connected to device: %s", this->get_name(), device_url_.c_str());
+  for (auto &vehicle : vehicles_) {
+    vehicle.connectionOpened();
   }
+  return true;
+}
+//}
 
-  if (!rclcpp::ok())
-    return;
+/* Vehicle constructor //{ */
+Vehicle::Vehicle(rclcpp::Node &node, mavsdk::Mavsdk &mavsdk, std::shared_ptr<CommandWorker> command_worker, std::shared_ptr<tf2_ros::Buffer> tf_buffer,
+                 std::shared_ptr<FlightRecorder> recorder, const vehicle_params_t &params, const std::string &name, const std::string &uav_name,
+                 const int system_id, const std::string &topic_prefix)
+    : uav_name_(uav_name),
+      node_(node),
+      name_(name),
+      topic_prefix_(topic_prefix),
+      system_id_(system_id),
+      mavsdk_(mavsdk),
+      command_worker_(command_worker),
+      waypoint_buffer_(params.waypoint_buffer_capacity),
+      tf_buffer_(tf_buffer),
+      recorder_(recorder),
+      yaw_offset_correction_(params.yaw_offset_correction),
+      takeoff_height_(params.takeoff_height),
+      waypoint_marker_scale_(params.waypoint_marker_scale),
+      control_update_rate_(params.control_update_rate),
+      waypoint_loiter_time_(params.waypoint_loiter_time),
+      reset_octomap_before_takeoff_(params.reset_octomap_before_takeoff),
+      waypoint_acceptance_radius_(params.waypoint_acceptance_radius),
+      target_velocity_(params.target_velocity),
+      command_timeout_(params.command_timeout),
+      verify_local_odom_with_tf_(params.verify_local_odom_with_tf),
+      mission_window_size_(params.mission_window_size),
+      mission_refill_threshold_(params.mission_refill_threshold),
+      stream_position_tolerance_(params.stream_position_tolerance),
+      stream_yaw_tolerance_(params.stream_yaw_tolerance),
+      offboard_control_(params.offboard_control),
+      offboard_setpoint_rate_(params.offboard_setpoint_rate),
+      latency_export_period_(params.latency_export_period),
+      waypoint_buffer_capacity_(params.waypoint_buffer_capacity),
+      simplify_position_tolerance_(params.simplify_tolerance_ratio * params.waypoint_acceptance_radius),
+      simplify_yaw_tolerance_(params.simplify_yaw_tolerance),
+      diagnostics_heartbeat_period_(params.diagnostics_heartbeat_period) {
+
+  if (params.flight_recorder_odometry_rate > 0.0) {
+    odometry_record_period_ = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(1.0 / params.flight_recorder_odometry_rate));
+  }
+
+  segment_limits_.max_speed             = params.target_velocity;
+  segment_limits_.max_acceleration      = params.max_acceleration;
+  segment_limits_.min_acceptance_radius = params.waypoint_acceptance_radius;
+  segment_limits_.max_acceptance_radius = params.max_acceptance_radius;
+  segment_limits_.max_fly_through_turn  = params.max_fly_through_turn;
+
+  buffer_credit_ = waypoint_buffer_capacity_;
+
+  sensors_.topics[sensor_stats_t::gps].setTimeout(params.gps_timeout);
+  sensors_.topics[sensor_stats_t::odometry].setTimeout(params.odometry_timeout);
+  sensors_.topics[sensor_stats_t::control_mode].setTimeout(params.control_mode_timeout);
+  sensors_.topics[sensor_stats_t::land_detected].setTimeout(params.land_detected_timeout);
 
-  RCLCPP_INFO(this->get_logger(), "[%s]: Target connected", this->get_name());
-  action_  = std::make_shared<mavsdk::Action>(system_);
-  mission_ = std::make_shared<mavsdk::Mission>(system_);
-  //}
+  /* frame definition */
+  world_frame_      = "world";
+  fcu_frame_        = uav_name_ + "/fcu";
+  ned_fcu_frame_    = uav_name_ + "/ned_fcu";
+  ned_origin_frame_ = uav_name_ + "/ned_origin";
+
+  tf2::Quaternion q;
+  q.setRPY(M_PI, 0, M_PI / 2);
+  q                    = q.inverse();
+  ned_origin_in_world_ = Eigen::Quaterniond(q.getW(), q.getX(), q.getY(), q.getZ());
+  q.setRPY(-M_PI, 0, 0);
+  fcu_in_ned_fcu_ = Eigen::Quaterniond(q.getW(), q.getX(), q.getY(), q.getZ());
+
+  // QoS of each topic from the config, validated by the node
+  const auto qos = [&params](const std::string &topic) { return qosProfile(params.qos.at(topic)); };
 
-  rclcpp::QoS qos(rclcpp::KeepLast(3));
   // publishers
-  vehicle_command_publisher_ = this->create_publisher<px4_msgs::msg::VehicleCommand>("~/vehicle_command_out", qos);
-  local_odom_publisher_      = this->create_publisher<nav_msgs::msg::Odometry>("~/local_odom_out", qos);
-  desired_pose_publisher_    = this->create_publisher<geometry_msgs::msg::PoseStamped>("~/desired_pose_out", qos);
-  waypoint_marker_publisher_ = this->create_publisher<geometry_msgs::msg::PoseArray>("~/waypoint_markers_out", qos);
-  diagnostics_publisher_     = this->create_publisher<fog_msgs::msg::ControlInterfaceDiagnostics>("~/diagnostics_out", qos);
+  vehicle_command_publisher_ = node_.create_publisher<px4_msgs::msg::VehicleCommand>(topic_prefix_ + "vehicle_command_out", qos("vehicle_command_out"));
+  local_odom_publisher_      = node_.create_publisher<nav_msgs::msg::Odometry>(topic_prefix_ + "local_odom_out", qos("local_odom_out"));
+  desired_pose_publisher_    = node_.create_publisher<geometry_msgs::msg::PoseStamped>(topic_prefix_ + "desired_pose_out", qos("desired_pose_out"));
+  waypoint_marker_publisher_ = node_.create_publisher<geometry_msgs::msg::PoseArray>(topic_prefix_ + "waypoint_markers_out", qos("waypoint_markers_out"));
+  diagnostics_publisher_ = node_.create_publisher<fog_msgs::msg::ControlInterfaceDiagnostics>(topic_prefix_ + "diagnostics_out", qos("diagnostics_out"));
+  // same topic and QoS as tf2_ros::TransformBroadcaster
+  tf_publisher_              = node_.create_publisher<tf2_msgs::msg::TFMessage>("/tf", rclcpp::QoS(rclcpp::KeepLast(100)));
+  if (offboard_control_) {
+    offboard_control_mode_publisher_ =
+        node_.create_publisher<px4_msgs::msg::OffboardControlMode>(topic_prefix_ + "offboard_control_mode_out", qos("offboard_control_mode_out"));
+    trajectory_setpoint_publisher_ =
+        node_.create_publisher<px4_msgs::msg::TrajectorySetpoint>(topic_prefix_ + "trajectory_setpoint_out", qos("trajectory_setpoint_out"));
+  }
+  latency_publisher_ = node_.create_publisher<diagnostic_msgs::msg::DiagnosticArray>(topic_prefix_ + "latency_out", qos("latency_out"));
+  // hidden topic between two callback groups of this node, always intra-process so that a wakeup is a pointer handoff
+  rclcpp::PublisherOptions wakeup_publisher_options;
+  wakeup_publisher_options.use_intra_process_comm = rclcpp::IntraProcessSetting::Enable;
+  wakeup_publisher_ = node_.create_publisher<std_msgs::msg::Empty>(topic_prefix_ + "_control_wakeup", rclcpp::QoS(1), wakeup_publisher_options);
 
   // subscribers
-  gps_subscriber_            = this->create_subscription<px4_msgs::msg::VehicleGlobalPosition>("~/gps_in", rclcpp::SystemDefaultsQoS(),
-                                                                                    std::bind(&ControlInterface::gpsCallback, this, _1));
-  pixhawk_odom_subscriber_   = this->create_subscription<px4_msgs::msg::VehicleOdometry>("~/pixhawk_odom_in", rclcpp::SystemDefaultsQoS(),
-                                                                                       std::bind(&ControlInterface::pixhawkOdomCallback, this, _1));
-  control_mode_subscriber_   = this->create_subscription<px4_msgs::msg::VehicleControlMode>("~/control_mode_in", rclcpp::SystemDefaultsQoS(),
-                                                                                          std::bind(&ControlInterface::controlModeCallback, this, _1));
-  land_detected_subscriber_  = this->create_subscription<px4_msgs::msg::VehicleLandDetected>("~/land_detected_in", rclcpp::SystemDefaultsQoS(),
-                                                                                            std::bind(&ControlInterface::landDetectedCallback, this, _1));
-  mission_result_subscriber_ = this->create_subscription<px4_msgs::msg::MissionResult>("~/mission_result_in", rclcpp::SystemDefaultsQoS(),
-                                                                                       std::bind(&ControlInterface::missionResultCallback, this, _1));
+  callback_group_           = node_.create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+  telemetry_callback_group_ = node_.create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+  command_callback_group_   = node_.create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+
+  rclcpp::SubscriptionOptions telemetry_options;
+  telemetry_options.callback_group = telemetry_callback_group_;
+  rclcpp::SubscriptionOptions control_options;
+  control_options.callback_group = callback_group_;
+  rclcpp::SubscriptionOptions wakeup_options;
+  wakeup_options.callback_group         = callback_group_;
+  wakeup_options.use_intra_process_comm = rclcpp::IntraProcessSetting::Enable;
+  // the waypoint stream shares the group with the services, which keeps a single producer of mission commands
+  rclcpp::SubscriptionOptions command_options;
+  command_options.callback_group = command_callback_group_;
+
+  gps_subscriber_             = node_.create_subscription<px4_msgs::msg::VehicleGlobalPosition>(
+      topic_prefix_ + "gps_in", qos("gps_in"), std::bind(&Vehicle::gpsCallback, this, _1), telemetry_options);
+  pixhawk_odom_subscriber_    = node_.create_subscription<px4_msgs::msg::VehicleOdometry>(
+      topic_prefix_ + "pixhawk_odom_in", qos("pixhawk_odom_in"), std::bind(&Vehicle::pixhawkOdomCallback, this, _1), telemetry_options);
+  control_mode_subscriber_    = node_.create_subscription<px4_msgs::msg::VehicleControlMode>(
+      topic_prefix_ + "control_mode_in", qos("control_mode_in"), std::bind(&Vehicle::controlModeCallback, this, _1), telemetry_options);
+  land_detected_subscriber_   = node_.create_subscription<px4_msgs::msg::VehicleLandDetected>(
+      topic_prefix_ + "land_detected_in", qos("land_detected_in"), std::bind(&Vehicle::landDetectedCallback, this, _1), telemetry_options);
+  mission_result_subscriber_  = node_.create_subscription<px4_msgs::msg::MissionResult>(
+      topic_prefix_ + "mission_result_in", qos("mission_result_in"), std::bind(&Vehicle::missionResultCallback, this, _1), control_options);
+  waypoint_stream_subscriber_ = node_.create_subscription<nav_msgs::msg::Path>(
+      topic_prefix_ + "waypoint_stream_in", qos("waypoint_stream_in"), std::bind(&Vehicle::waypointStreamCallback, this, _1), command_options);
+  timesync_subscriber_        = node_.create_subscription<px4_msgs::msg::Timesync>(
+      topic_prefix_ + "timesync_in", qos("timesync_in"), std::bind(&Vehicle::timesyncCallback, this, _1), telemetry_options);
+  wakeup_subscriber_          = node_.create_subscription<std_msgs::msg::Empty>(
+      topic_prefix_ + "_control_wakeup", rclcpp::QoS(1), std::bind(&Vehicle::wakeupCallback, this, _1), wakeup_options);
 
   // service handlers
-  arming_service_         = this->create_service<std_srvs::srv::SetBool>("~/arming_in", std::bind(&ControlInterface::armingCallback, this, _1, _2));
-  takeoff_service_        = this->create_service<std_srvs::srv::Trigger>("~/takeoff_in", std::bind(&ControlInterface::takeoffCallback, this, _1, _2));
-  land_service_           = this->create_service<std_srvs::srv::Trigger>("~/land_in", std::bind(&ControlInterface::landCallback, this, _1, _2));
-  local_waypoint_service_ = this->create_service<fog_msgs::srv::Vec4>("~/local_waypoint_in", std::bind(&ControlInterface::localWaypointCallback, this, _1, _2));
-  local_path_service_     = this->create_service<fog_msgs::srv::Path>("~/local_path_in", std::bind(&ControlInterface::localPathCallback, this, _1, _2));
-  gps_waypoint_service_   = this->create_service<fog_msgs::srv::Vec4>("~/gps_waypoint_in", std::bind(&ControlInterface::gpsWaypointCallback, this, _1, _2));
-  gps_path_service_       = this->create_service<fog_msgs::srv::Path>("~/gps_path_in", std::bind(&ControlInterface::gpsPathCallback, this, _1, _2));
-  waypoint_to_local_service_ =
-      this->create_service<fog_msgs::srv::WaypointToLocal>("~/waypoint_to_local_in", std::bind(&ControlInterface::waypointToLocalCallback, this, _1, _2));
-  path_to_local_service_ =
-      this->create_service<fog_msgs::srv::PathToLocal>("~/path_to_local_in", std::bind(&ControlInterface::pathToLocalCallback, this, _1, _2));
+  // services wait for MAVSDK acknowledgements, keep them in a separate group so that they do not block odometry and the control loop
+  arming_service_            = node_.create_service<std_srvs::srv::SetBool>(topic_prefix_ + "arming_in", std::bind(&Vehicle::armingCallback, this, _1, _2),
+                                                                            rmw_qos_profile_services_default, command_callback_group_);
+  takeoff_service_           = node_.create_service<std_srvs::srv::Trigger>(topic_prefix_ + "takeoff_in", std::bind(&Vehicle::takeoffCallback, this, _1, _2),
+                                                                            rmw_qos_profile_services_default, command_callback_group_);
+  land_service_              = node_.create_service<std_srvs::srv::Trigger>(topic_prefix_ + "land_in", std::bind(&Vehicle::landCallback, this, _1, _2),
+                                                                            rmw_qos_profile_services_default, command_callback_group_);
+  local_waypoint_service_    = node_.create_service<fog_msgs::srv::Vec4>(
+      topic_prefix_ + "local_waypoint_in", std::bind(&Vehicle::localWaypointCallback, this, _1, _2), rmw_qos_profile_services_default, command_callback_group_);
+  local_path_service_        = node_.create_service<fog_msgs::srv::Path>(topic_prefix_ + "local_path_in", std::bind(&Vehicle::localPathCallback, this, _1, _2),
+                                                                         rmw_qos_profile_services_default, command_callback_group_);
+  gps_waypoint_service_      = node_.create_service<fog_msgs::srv::Vec4>(
+      topic_prefix_ + "gps_waypoint_in", std::bind(&Vehicle::gpsWaypointCallback, this, _1, _2), rmw_qos_profile_services_default, command_callback_group_);
+  gps_path_service_          = node_.create_service<fog_msgs::srv::Path>(topic_prefix_ + "gps_path_in", std::bind(&Vehicle::gpsPathCallback, this, _1, _2),
+                                                                         rmw_qos_profile_services_default, command_callback_group_);
+  waypoint_to_local_service_ = node_.create_service<fog_msgs::srv::WaypointToLocal>(
+      topic_prefix_ + "waypoint_to_local_in", std::bind(&Vehicle::waypointToLocalCallback, this, _1, _2), rmw_qos_profile_services_default,
+      command_callback_group_);
+  path_to_local_service_     = node_.create_service<fog_msgs::srv::PathToLocal>(topic_prefix_ + "path_to_local_in",
+                                                                                std::bind(&Vehicle::pathToLocalCallback, this, _1, _2),
+                                                                                rmw_qos_profile_services_default, command_callback_group_);
 
   control_timer_ =
-      this->create_wall_timer(std::chrono::duration<double>(1.0 / control_update_rate_), std::bind(&ControlInterface::controlRoutine, this), callback_group_);
-
-  octomap_reset_client_ = this->create_client<std_srvs::srv::Empty>("~/octomap_reset_out");
+      node_.create_wall_timer(std::chrono::duration<double>(1.0 / control_update_rate_), std::bind(&Vehicle::controlRoutine, this), callback_group_);
+  if (offboard_control_) {
+    // same group as the control loop, the setpoints are generated from the waypoint buffer it owns
+    offboard_timer_ =
+        node_.create_wall_timer(std::chrono::duration<double>(1.0 / offboard_setpoint_rate_), std::bind(&Vehicle::offboardRoutine, this), callback_group_);
+  }
+
+  // latency services only read and reset atomics, the control group keeps them responsive while other services wait for MAVSDK
+  latency_dump_service_  = node_.create_service<std_srvs::srv::Trigger>(
+      topic_prefix_ + "latency_dump_in", std::bind(&Vehicle::latencyDumpCallback, this, _1, _2), rmw_qos_profile_services_default, callback_group_);
+  latency_reset_service_ = node_.create_service<std_srvs::srv::Trigger>(
+      topic_prefix_ + "latency_reset_in", std::bind(&Vehicle::latencyResetCallback, this, _1, _2), rmw_qos_profile_services_default, callback_group_);
+  if (latency_export_period_ > 0.0) {
+    latency_timer_ =
+        node_.create_wall_timer(std::chrono::duration<double>(latency_export_period_), std::bind(&Vehicle::publishLatency, this), callback_group_);
+  }
+
+  octomap_reset_client_ = node_.create_client<std_srvs::srv::Empty>(topic_prefix_ + "octomap_reset_out");
+
+  using Gate               = PreconditionGate;
+  arming_guard_            = Gate::guard("Arming rejected", Gate::mask(Gate::initialized, Gate::sensors, Gate::connected));
+  takeoff_guard_           = Gate::guard("Takeoff rejected", Gate::mask(Gate::initialized, Gate::sensors, Gate::connected, Gate::armed, Gate::landed));
+  land_guard_              = Gate::guard("Landing rejected", Gate::mask(Gate::initialized, Gate::sensors, Gate::connected, Gate::armed, Gate::airborne));
+  local_waypoint_guard_    = Gate::guard("Waypoint not set", Gate::mask(Gate::initialized, Gate::sensors, Gate::airborne));
+  local_path_guard_        = Gate::guard("Waypoints not set", Gate::mask(Gate::initialized, Gate::sensors));
+  gps_waypoint_guard_      = Gate::guard("Waypoint not set", Gate::mask(Gate::initialized, Gate::sensors, Gate::airborne));
+  gps_path_guard_          = Gate::guard("Waypoints not set", Gate::mask(Gate::initialized, Gate::sensors));
+  waypoint_to_local_guard_ = Gate::guard("Cannot transform coordinates", Gate::mask(Gate::initialized, Gate::sensors));
+  path_to_local_guard_     = Gate::guard("Cannot transform coordinates", Gate::mask(Gate::initialized, Gate::sensors));
+  gate_.set(Gate::landed, landed_);
+  gate_.set(Gate::airborne, !landed_);
 
-  tf_broadcaster_        = nullptr;
   static_tf_broadcaster_ = nullptr;
 
-  desired_pose_ = Eigen::Vector4d(0.0, 0.0, 0.0, 0.0);
-
-  tf_buffer_ = std::make_shared<tf2_ros::Buffer>(this->get_clock());
-  tf_buffer_->setUsingDedicatedThread(true);
-  tf_listener_ = std::make_shared<tf2_ros::TransformListener>(*tf_buffer_, this, false);
+  tf_msg_.transforms.resize(1);
+  tf_msg_.transforms[0].header.frame_id = ned_origin_frame_;
+  tf_msg_.transforms[0].child_frame_id  = ned_fcu_frame_;
+  local_odom_msg_.header.frame_id       = world_frame_;
+  local_odom_msg_.child_frame_id        = fcu_frame_;
+  desired_pose_msg_.header.frame_id     = world_frame_;
 
   is_initialized_ = true;
-  RCLCPP_INFO(this->get_logger(), "[%s]: Initialized", this->get_name());
+  gate_.set(PreconditionGate::initialized, true);
+  RCLCPP_INFO(node_.get_logger(), "[%s]: Initialized", name_.c_str());
+}
+//}
+
+/* Vehicle destructor //{ */
+Vehicle::~Vehicle() {
+  if (system_ != nullptr) {
+    system_->subscribe_is_connected(nullptr);
+  }
+}
+//}
+
+/* connectionOpened //{ */
+void Vehicle::connectionOpened() {
+  link_state_t expected = link_state_t::no_connection;
+  link_state_.compare_exchange_strong(expected, link_state_t::waiting_for_system);
+}
+//}
+
+/* newSystemDiscovered //{ */
+void Vehicle::newSystemDiscovered() {
+  new_system_discovered_ = true;
+}
+//}
+
+/* messageReceived //{ */
+void Vehicle::messageReceived(const uint8_t system_id, const uint8_t component_id, const uint8_t seq) {
+  if (system_id != system_id_) {
+    return;
+  }
+  link_.received++;
+  // every component numbers its messages on its own, only the autopilot sequence is followed
+  if (component_id != MAV_COMP_ID_AUTOPILOT1) {
+    return;
+  }
+  if (link_.last_seq >= 0) {
+    link_.lost += uint8_t(seq - link_.last_seq - 1);
+  }
+  link_.last_seq = seq;
+}
+//}
+
+/* messageSent //{ */
+void Vehicle::messageSent(const int target_system, const uint32_t message_id, const bool retransmission) {
+  if (target_system != system_id_) {
+    return;
+  }
+  link_.sent++;
+  if (retransmission) {
+    link_.command_retries++;
+  }
+  if (message_id == MAVLINK_MSG_ID_MISSION_ITEM_INT) {
+    link_.mission_items++;
+  }
+}
+//}
+
+/* updateLink //{ */
+void Vehicle::updateLink() {
+
+  switch (link_state_) {
+    case link_state_t::no_connection: {
+      // the shared connection is opened by the node
+      break;
+    }
+
+    case link_state_t::waiting_for_system: {
+      if (!new_system_discovered_.exchange(false)) {
+        RCLCPP_INFO_THROTTLE(node_.get_logger(), *node_.get_clock(), 1000, "[%s]: Waiting for system ID %d", name_.c_str(), system_id_);
+        break;
+      }
+      for (auto &system : mavsdk_.systems()) {
+        if (system->get_system_id() == system_id_) {
+          system_     = system;
+          commands_   = std::make_shared<CommandChannel>(command_worker_, system_, name_, latency_, takeoff_height_);
+          link_state_ = link_state_t::connected;
+          gate_.set(PreconditionGate::connected, true);
+          system_->subscribe_is_connected([this](bool connected) {
+            link_state_ = connected ? link_state_t::connected : link_state_t::lost;
+            gate_.set(PreconditionGate::connected, connected);
+          });
+          RCLCPP_INFO(node_.get_logger(), "[%s]: Target connected, ID: %d", name_.c_str(), system_id_);
+          break;
+        }
+      }
+      break;
+    }
+
+    case link_state_t::connected: {
+      if (last_link_state_ == link_state_t::lost) {
+        RCLCPP_WARN(node_.get_logger(), "[%s]: Vehicle link restored", name_.c_str());
+        // the vehicle may have dropped commands sent while the link was down, upload the current part of the path again
+        if (motion_started_ && !offboard_control_ && mission_window_.size() > 0) {
+          fillMissionWindow();
+          start_mission_ = true;
+        }
+      }
+      break;
+    }
+
+    case link_state_t::lost: {
+      if (last_link_state_ != link_state_t::lost) {
+        RCLCPP_ERROR(node_.get_logger(), "[%s]: Vehicle link lost", name_.c_str());
+        // the vehicle may reboot or drop an upload in progress, its plan is unknown until the next upload
+        vehicle_plan_.clear();
+      }
+      break;
+    }
+  }
+
+  last_link_state_ = link_state_;
+}
+//}
+
+/* vehicleConnected //{ */
+bool Vehicle::vehicleConnected() {
+  return link_state_ == link_state_t::connected;
 }
 //}
 
 /* gpsCallback //{ */
-void ControlInterface::gpsCallback(const px4_msgs::msg::VehicleGlobalPosition::UniquePtr msg) {
+void Vehicle::gpsCallback(const px4_msgs::msg::VehicleGlobalPosition::UniquePtr msg) {
   if (!is_initialized_) {
     return;
   }
 
-  if (!getting_gps_) {
-    mavsdk::geometry::CoordinateTransformation::GlobalCoordinate ref;
-    ref.latitude_deg  = msg->lat;
-    ref.longitude_deg = msg->lon;
-    coord_transform_  = std::make_shared<mavsdk::geometry::CoordinateTransformation>(mavsdk::geometry::CoordinateTransformation(ref));
+  if (!sensors_.topics[sensor_stats_t::gps].everReceived()) {
+    coord_transform_ = std::make_shared<GeodeticTransform>(msg->lat, msg->lon);
   }
 
-  this->latitude_  = msg->lat;
-  this->longitude_ = msg->lon;
-  this->altitude_  = msg->alt;
-  getting_gps_     = true;
-  RCLCPP_INFO_ONCE(this->get_logger(), "[%s]: Getting gps!", this->get_name());
+  global_position_t position;
+  position.latitude  = msg->lat;
+  position.longitude = msg->lon;
+  position.altitude  = msg->alt;
+  global_position_.store(position);
+  sensorReceived(sensor_stats_t::gps);
+  RCLCPP_INFO_ONCE(node_.get_logger(), "[%s]: Getting gps!", name_.c_str());
 }
 //}
 
 /* pixhawkOdomCallback //{ */
-void ControlInterface::pixhawkOdomCallback(const px4_msgs::msg::VehicleOdometry::UniquePtr msg) {
+void Vehicle::pixhawkOdomCallback(const px4_msgs::msg::VehicleOdometry::UniquePtr msg) {
   if (!is_initialized_) {
     return;
   }
+  const auto    callback_start = std::chrono::steady_clock::now();
+  ScopedLatency scoped_latency(latency_->histograms[latency_stats_t::odometry_callback]);
+
+  vehicle_odometry_t odom;
+  odom.pos[0] = msg->x;
+  odom.pos[1] = msg->y;
+  odom.pos[2] = msg->z;
+  odom.ori[0] = msg->q[0];
+  odom.ori[1] = msg->q[1];
+  odom.ori[2] = msg->q[2];
+  odom.ori[3] = msg->q[3];
+  odometry_.store(odom);
+
+  if (recorder_ != nullptr && callback_start - last_odometry_record_ >= odometry_record_period_) {
+    last_odometry_record_ = callback_start;
+    recorder_->record(flight_record_t::odometry, system_id_, 0, {odom.pos[0], odom.pos[1], odom.pos[2], getYaw(odom.ori)});
+  }
 
-  pos_[0] = msg->x;
-  pos_[1] = msg->y;
-  pos_[2] = msg->z;
-  ori_[0] = msg->q[0];
-  ori_[1] = msg->q[1];
-  ori_[2] = msg->q[2];
-  ori_[3] = msg->q[3];
+  sensorReceived(sensor_stats_t::odometry);
+  RCLCPP_INFO_ONCE(node_.get_logger(), "[%s]: Getting pixhawk odometry!", name_.c_str());
 
-  getting_pixhawk_odom_ = true;
-  RCLCPP_INFO_ONCE(this->get_logger(), "[%s]: Getting pixhawk odometry!", this->get_name());
+#ifdef CONTROL_INTERFACE_COUNT_ALLOCATIONS
+  const uint64_t allocations_before = threadAllocations();
+#endif
 
-  publishTF();
-  publishLocalOdom();
-  publishDesiredPose();
+  const rclcpp::Time stamp = node_.get_clock()->now();
+  publishTF(odom, stamp);
+  // odometry to TF latency, as seen by this node
+  latency_->histograms[latency_stats_t::tf_publish].record(std::chrono::steady_clock::now() - callback_start);
+  publishLocalOdom(odom, stamp);
+  publishDesiredPose(stamp);
+
+#ifdef CONTROL_INTERFACE_COUNT_ALLOCATIONS
+  const uint64_t allocations = threadAllocations() - allocations_before;
+  if (allocations > 0) {
+    RCLCPP_WARN_THROTTLE(node_.get_logger(), *node_.get_clock(), 1000, "[%s]: %lu heap allocations while publishing odometry", name_.c_str(), allocations);
+  }
+#endif
 
   // one-shot publish static TF
   if (static_tf_broadcaster_ == nullptr) {
-    static_tf_broadcaster_ = std::make_shared<tf2_ros::StaticTransformBroadcaster>(this->shared_from_this());
+    // transient local durability is not supported by intra-process communication
+    rclcpp::PublisherOptions static_tf_options;
+    static_tf_options.use_intra_process_comm = rclcpp::IntraProcessSetting::Disable;
+    static_tf_broadcaster_ =
+        std::make_shared<tf2_ros::StaticTransformBroadcaster>(node_.shared_from_this(), tf2_ros::StaticBroadcasterQoS(), static_tf_options);
     publishStaticTF();
   }
 }
 //}
 
 /* controlModeCallback //{ */
-void ControlInterface::controlModeCallback(const px4_msgs::msg::VehicleControlMode::UniquePtr msg) {
+void Vehicle::controlModeCallback(const px4_msgs::msg::VehicleControlMode::UniquePtr msg) {
   if (!is_initialized_) {
     return;
   }
 
-  getting_control_mode_ = true;
+  sensorReceived(sensor_stats_t::control_mode);
+  offboard_enabled_ = msg->flag_control_offboard_enabled;
 
   if (armed_ != msg->flag_armed) {
     armed_ = msg->flag_armed;
+    gate_.set(PreconditionGate::armed, armed_);
     if (armed_) {
-      RCLCPP_WARN(this->get_logger(), "[%s]: Vehicle armed", this->get_name());
+      RCLCPP_WARN(node_.get_logger(), "[%s]: Vehicle armed", name_.c_str());
     } else {
       takeoff_requested_ = false;
       start_mission_     = false;
       motion_started_    = false;
-      RCLCPP_WARN(this->get_logger(), "[%s]: Vehicle disarmed", this->get_name());
+      RCLCPP_WARN(node_.get_logger(), "[%s]: Vehicle disarmed", name_.c_str());
     }
   }
 }
 //}
 
 /* landDetectedCallback //{ */
-void ControlInterface::landDetectedCallback(const px4_msgs::msg::VehicleLandDetected::UniquePtr msg) {
+void Vehicle::landDetectedCallback(const px4_msgs::msg::VehicleLandDetected::UniquePtr msg) {
   if (!is_initialized_) {
     return;
   }
-  getting_landed_info_ = true;
+  sensorReceived(sensor_stats_t::land_detected);
   // checking only ground_contact flag instead of landed due to a problem in simulation
   landed_ = msg->ground_contact;
+  gate_.set(PreconditionGate::landed, landed_);
+  gate_.set(PreconditionGate::airborne, !landed_);
 }
 //}
 
 /* missionResultCallback //{ */
-void ControlInterface::missionResultCallback(const px4_msgs::msg::MissionResult::UniquePtr msg) {
+void Vehicle::missionResultCallback(const px4_msgs::msg::MissionResult::UniquePtr msg) {
   if (!is_initialized_) {
     return;
   }
 
-  unsigned instance_count = msg->instance_count;
+  unsigned instance_count  = msg->instance_count;
+  mission_result_instance_ = instance_count;
+
+  // result of a mission which has already been replaced by a newer upload
+  if (instance_count == replaced_mission_instance_) {
+    return;
+  }
+
+  // PX4 counts the MAVLink items, the mission window counts the items of the plan
+  bool      progressed   = false;
+  const int item_reached = missionItemReached(vehicle_plan_seq_, msg->seq_reached);
+  if (item_reached > mission_seq_reached_) {
+    mission_seq_reached_ = item_reached;
+    progressed           = true;
+  }
 
   if (msg->finished && instance_count != last_mission_instance_) {
     mission_finished_      = true;
     last_mission_instance_ = msg->instance_count;
+    // PX4 would not report a restarted mission as finished again, the next plan is always uploaded
+    vehicle_plan_.clear();
+    progressed = true;
+  }
+
+  if (progressed && recorder_ != nullptr) {
+    recorder_->record(flight_record_t::mission_progress, system_id_, mission_seq_reached_,
+                      {double(instance_count), msg->finished ? 1.0 : 0.0, double(msg->seq_reached)});
+  }
+
+  // same callback group as the control loop, the next part of the path is sent right away instead of on the next tick
+  if (progressed) {
+    missionRoutine();
   }
 }
 //}
 
-/* takeoffCallback //{ */
-bool ControlInterface::takeoffCallback([[maybe_unused]] const std::shared_ptr<std_srvs::srv::Trigger::Request> request,
-                                       std::shared_ptr<std_srvs::srv::Trigger::Response>                       response) {
+/* wakeupCallback //{ */
+void Vehicle::wakeupCallback([[maybe_unused]] const std_msgs::msg::Empty::UniquePtr msg) {
+  // cleared before the commands are drained, a command pushed meanwhile sends another wakeup
+  wakeup_pending_ = false;
+  latency_->histograms[latency_stats_t::control_wakeup].record(
+      std::chrono::steady_clock::duration(std::chrono::steady_clock::now().time_since_epoch().count() - wakeup_requested_.load()));
 
   if (!is_initialized_) {
-    response->success = false;
-    response->message = "Takeoff rejected, not initialized";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
-    return true;
+    return;
+  }
+  missionRoutine();
+}
+//}
+
+/* timesyncCallback //{ */
+void Vehicle::timesyncCallback(const px4_msgs::msg::Timesync::UniquePtr msg) {
+  px4_timestamp_ = msg->timestamp;
+}
+//}
+
+/* waypointStreamCallback //{ */
+void Vehicle::waypointStreamCallback(const nav_msgs::msg::Path::UniquePtr msg) {
+  ScopedLatency scoped_latency(latency_->histograms[latency_stats_t::waypoint_stream_callback]);
+  if (!is_initialized_) {
+    return;
   }
 
   if (!gettingPixhawkSensors()) {
-    response->success = false;
-    response->message = "Takeoff rejected, missing Pixhawk sensors";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
-    return true;
+    RCLCPP_WARN_THROTTLE(node_.get_logger(), *node_.get_clock(), 1000, "[%s]: Waypoint stream ignored, missing Pixhawk sensors", name_.c_str());
+    return;
   }
 
-  if (!armed_) {
-    response->success = false;
-    response->message = "Takeoff rejected, vehicle not armed";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
-    return true;
+  if (msg->poses.size() < 1) {
+    RCLCPP_WARN_THROTTLE(node_.get_logger(), *node_.get_clock(), 1000, "[%s]: Waypoint stream ignored, path is empty", name_.c_str());
+    return;
   }
 
-  if (!landed_) {
-    response->success = false;
-    response->message = "Takeoff rejected, vehicle not landed";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
+  // the planner may publish faster than the transport delivers, never go back to an older plan
+  const int64_t stamp = rclcpp::Time(msg->header.stamp).nanoseconds();
+  if (stamp != 0 && stamp <= last_waypoint_stream_stamp_) {
+    RCLCPP_WARN(node_.get_logger(), "[%s]: Waypoint stream message out of order, dropping it", name_.c_str());
+    return;
+  }
+
+  const std::vector<double>     yaws = getYaw(*msg);
+  std::vector<local_waypoint_t> route(msg->poses.size());
+  for (size_t i = 0; i < msg->poses.size(); i++) {
+    route[i].x   = msg->poses[i].pose.position.x;
+    route[i].y   = msg->poses[i].pose.position.y;
+    route[i].z   = msg->poses[i].pose.position.z;
+    route[i].yaw = yaws[i];
+  }
+
+  // simplified the same way as the paths of the services, so that an unchanged route still matches the uploaded window
+  simplify(route);
+  mission_command_t command;
+  command.type      = mission_command_t::type_t::splice;
+  command.waypoints = std::move(route);
+  if (!mission_commands_.push(std::move(command))) {
+    RCLCPP_ERROR(node_.get_logger(), "[%s]: Waypoint stream dropped, command queue is full", name_.c_str());
+    return;
+  }
+  wakeControlLoop();
+  if (stamp != 0) {
+    last_waypoint_stream_stamp_ = stamp;
+  }
+}
+//}
+
+/* takeoffCallback //{ */
+bool Vehicle::takeoffCallback([[maybe_unused]] const std::shared_ptr<std_srvs::srv::Trigger::Request> request,
+                              std::shared_ptr<std_srvs::srv::Trigger::Response>                       response) {
+  ScopedLatency scoped_latency(latency_->histograms[latency_stats_t::takeoff_service]);
+
+  if (!admit(takeoff_guard_, *response)) {
     return true;
   }
 
@@ -562,34 +1343,11 @@ bool ControlInterface::takeoffCallback([[maybe_unused]] const std::shared_ptr<st
 //}
 
 /* landCallback //{ */
-bool ControlInterface::landCallback([[maybe_unused]] const std::shared_ptr<std_srvs::srv::Trigger::Request> request,
-                                    std::shared_ptr<std_srvs::srv::Trigger::Response>                       response) {
+bool Vehicle::landCallback([[maybe_unused]] const std::shared_ptr<std_srvs::srv::Trigger::Request> request,
+                           std::shared_ptr<std_srvs::srv::Trigger::Response>                       response) {
+  ScopedLatency scoped_latency(latency_->histograms[latency_stats_t::land_service]);
 
-  if (!is_initialized_) {
-    response->success = false;
-    response->message = "Landing rejected, not initialized";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
-    return true;
-  }
-
-  if (!gettingPixhawkSensors()) {
-    response->success = false;
-    response->message = "Landing rejected, missing Pixhawk sensors";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
-    return true;
-  }
-
-  if (!armed_) {
-    response->success = false;
-    response->message = "Landing rejected, vehicle not armed";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
-    return true;
-  }
-
-  if (landed_) {
-    response->success = false;
-    response->message = "Landing rejected, vehicle not airborne";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
+  if (!admit(land_guard_, *response)) {
     return true;
   }
 
@@ -606,49 +1364,43 @@ bool ControlInterface::landCallback([[maybe_unused]] const std::shared_ptr<std_s
 //}
 
 /* armingCallback //{ */
-bool ControlInterface::armingCallback([[maybe_unused]] const std::shared_ptr<std_srvs::srv::SetBool::Request> request,
-                                      std::shared_ptr<std_srvs::srv::SetBool::Response>                       response) {
+bool Vehicle::armingCallback([[maybe_unused]] const std::shared_ptr<std_srvs::srv::SetBool::Request> request,
+                             std::shared_ptr<std_srvs::srv::SetBool::Response>                       response) {
+  ScopedLatency scoped_latency(latency_->histograms[latency_stats_t::arming_service]);
 
-  if (!is_initialized_) {
-    response->success = false;
-    response->message = "Arming rejected, not initialized";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
+  if (!admit(arming_guard_, *response)) {
     return true;
   }
 
-  if (!gettingPixhawkSensors()) {
-    response->success = false;
-    response->message = "Arming rejected, missing Pixhawk sensors";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
-    return true;
-  }
+  // blocks only the command callback group until the vehicle acknowledges
+  auto result = request->data ? commands_->arm().get() : commands_->disarm().get();
 
   if (request->data) {
-    auto result = action_->arm();
-    if (result != mavsdk::Action::Result::Success) {
+    if (!result.success) {
       response->message = "Arming failed";
       response->success = false;
-      RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
+      RCLCPP_ERROR(node_.get_logger(), "[%s]: %s", name_.c_str(), response->message.c_str());
       return true;
     } else {
       response->message = "Vehicle armed";
       response->success = true;
       armed_            = true;
-      RCLCPP_WARN(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
+      gate_.set(PreconditionGate::armed, true);
+      RCLCPP_WARN(node_.get_logger(), "[%s]: %s", name_.c_str(), response->message.c_str());
       return true;
     }
   } else {
-    auto result = action_->disarm();
-    if (result != mavsdk::Action::Result::Success) {
+    if (!result.success) {
       response->message = "Disarming failed";
       response->success = false;
-      RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
+      RCLCPP_ERROR(node_.get_logger(), "[%s]: %s", name_.c_str(), response->message.c_str());
       return true;
     } else {
       response->message = "Vehicle disarmed";
       response->success = true;
       armed_            = false;
-      RCLCPP_WARN(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
+      gate_.set(PreconditionGate::armed, false);
+      RCLCPP_WARN(node_.get_logger(), "[%s]: %s", name_.c_str(), response->message.c_str());
       return true;
     }
   }
@@ -656,93 +1408,90 @@ bool ControlInterface::armingCallback([[maybe_unused]] const std::shared_ptr<std
 //}
 
 /* localWaypointCallback //{ */
-bool ControlInterface::localWaypointCallback(const std::shared_ptr<fog_msgs::srv::Vec4::Request> request,
-                                             std::shared_ptr<fog_msgs::srv::Vec4::Response>      response) {
-
-  if (!is_initialized_) {
-    response->success = false;
-    response->message = "Waypoint not set, not initialized";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
-    return true;
-  }
+bool Vehicle::localWaypointCallback(const std::shared_ptr<fog_msgs::srv::Vec4::Request> request,
+                                    std::shared_ptr<fog_msgs::srv::Vec4::Response>      response) {
+  ScopedLatency scoped_latency(latency_->histograms[latency_stats_t::local_waypoint_service]);
 
-  if (!gettingPixhawkSensors()) {
-    response->success = false;
-    response->message = "Waypoint not set, missing Pixhawk sensors";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
+  if (!admit(local_waypoint_guard_, *response)) {
     return true;
   }
 
-  if (landed_) {
-    response->success = false;
-    response->message = "Waypoint not set, vehicle not airborne";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
+  if (!fitsBuffer(1, "Waypoint not set", *response)) {
     return true;
   }
 
   if (!stopPreviousMission()) {
     response->success = false;
     response->message = "Waypoint not set, previous mission cannot be aborted";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
+    RCLCPP_ERROR(node_.get_logger(), "[%s]: %s", name_.c_str(), response->message.c_str());
     return true;
   }
 
-  response->message = "Waypoint set";
-  response->success = true;
-  RCLCPP_INFO(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
-
   local_waypoint_t w;
   w.x   = request->goal[0];
   w.y   = request->goal[1];
   w.z   = request->goal[2];
   w.yaw = request->goal[3];
-  waypoint_buffer_.push_back(w);
-  motion_started_ = true;
+  if (!addWaypoints({w})) {
+    response->success = false;
+    response->message = "Waypoint not set, waypoint buffer or command queue is full";
+    RCLCPP_ERROR(node_.get_logger(), "[%s]: %s", name_.c_str(), response->message.c_str());
+    return true;
+  }
+
+  response->message = "Waypoint set";
+  response->success = true;
+  RCLCPP_INFO(node_.get_logger(), "[%s]: %s", name_.c_str(), response->message.c_str());
   return true;
 }
 //}
 
 /* localPathCallback //{ */
-bool ControlInterface::localPathCallback(const std::shared_ptr<fog_msgs::srv::Path::Request> request, std::shared_ptr<fog_msgs::srv::Path::Response> response) {
+bool Vehicle::localPathCallback(const std::shared_ptr<fog_msgs::srv::Path::Request> request, std::shared_ptr<fog_msgs::srv::Path::Response> response) {
+  ScopedLatency scoped_latency(latency_->histograms[latency_stats_t::local_path_service]);
 
-  if (!is_initialized_) {
-    response->success = false;
-    response->message = "Waypoints not set, not initialized";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
+  if (!admit(local_path_guard_, *response)) {
     return true;
   }
 
-  if (!gettingPixhawkSensors()) {
+  if (request->path.poses.size() < 1) {
     response->success = false;
-    response->message = "Waypoints not set, missing Pixhawk sensors";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
+    response->message = "Waypoints not set, request is empty";
+    RCLCPP_ERROR(node_.get_logger(), "[%s]: %s", name_.c_str(), response->message.c_str());
     return true;
   }
 
-  if (request->path.poses.size() < 1) {
-    response->success = false;
-    response->message = "Waypoints not set, request is empty";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
+  const std::vector<double>     yaws = getYaw(request->path);
+  std::vector<local_waypoint_t> waypoints;
+  waypoints.reserve(request->path.poses.size());
+  for (size_t i = 0; i < request->path.poses.size(); i++) {
+    local_waypoint_t w;
+    w.x   = request->path.poses[i].pose.position.x;
+    w.y   = request->path.poses[i].pose.position.y;
+    w.z   = request->path.poses[i].pose.position.z;
+    w.yaw = yaws[i];
+    waypoints.push_back(w);
+  }
+  simplify(waypoints);
+  RCLCPP_INFO(node_.get_logger(), "[%s]: Got %ld waypoints, %ld after simplification", name_.c_str(), request->path.poses.size(), waypoints.size());
+
+  if (!fitsBuffer(waypoints.size(), "Waypoints not set", *response)) {
     return true;
   }
 
   if (!stopPreviousMission()) {
     response->success = false;
     response->message = "Waypoints not set, previous mission cannot be aborted";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
+    RCLCPP_ERROR(node_.get_logger(), "[%s]: %s", name_.c_str(), response->message.c_str());
     return true;
   }
 
-  RCLCPP_INFO(this->get_logger(), "[%s]: Got %d waypoints", this->get_name(), request->path.poses.size());
-  for (size_t i = 0; i < request->path.poses.size(); i++) {
-    local_waypoint_t w;
-    w.x   = request->path.poses[i].pose.position.x;
-    w.y   = request->path.poses[i].pose.position.y;
-    w.z   = request->path.poses[i].pose.position.z;
-    w.yaw = getYaw(request->path.poses[i].pose.orientation);
-    waypoint_buffer_.push_back(w);
+  if (!addWaypoints(std::move(waypoints))) {
+    response->success = false;
+    response->message = "Waypoints not set, waypoint buffer or command queue is full";
+    RCLCPP_ERROR(node_.get_logger(), "[%s]: %s", name_.c_str(), response->message.c_str());
+    return true;
   }
-  motion_started_   = true;
   response->success = true;
   response->message = "Waypoints set";
   return true;
@@ -750,93 +1499,89 @@ bool ControlInterface::localPathCallback(const std::shared_ptr<fog_msgs::srv::Pa
 //}
 
 /* gpsWaypointCallback //{ */
-bool ControlInterface::gpsWaypointCallback(const std::shared_ptr<fog_msgs::srv::Vec4::Request> request,
-                                           std::shared_ptr<fog_msgs::srv::Vec4::Response>      response) {
+bool Vehicle::gpsWaypointCallback(const std::shared_ptr<fog_msgs::srv::Vec4::Request> request,
+                                  std::shared_ptr<fog_msgs::srv::Vec4::Response>      response) {
+  ScopedLatency scoped_latency(latency_->histograms[latency_stats_t::gps_waypoint_service]);
 
-  if (!is_initialized_) {
-    response->success = false;
-    response->message = "Waypoint not set, not initialized";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
+  if (!admit(gps_waypoint_guard_, *response)) {
     return true;
   }
 
-  if (!gettingPixhawkSensors()) {
-    response->success = false;
-    response->message = "Waypoint not set, missing Pixhawk sensors";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
-    return true;
-  }
-
-  if (landed_) {
-    response->success = false;
-    response->message = "Waypoint not set, vehicle not airborne";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
+  if (!fitsBuffer(1, "Waypoint not set", *response)) {
     return true;
   }
 
   if (!stopPreviousMission()) {
     response->success = false;
     response->message = "Waypoint not set, previous mission cannot be aborted";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
+    RCLCPP_ERROR(node_.get_logger(), "[%s]: %s", name_.c_str(), response->message.c_str());
     return true;
   }
 
-  response->message = "Waypoint set";
-  response->success = true;
-  RCLCPP_INFO(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
-
   gps_waypoint_t w;
   w.latitude  = request->goal[0];
   w.longitude = request->goal[1];
   w.altitude  = request->goal[2];
   w.yaw       = request->goal[3];
-  waypoint_buffer_.push_back(globalToLocal(coord_transform_, w));
-  motion_started_ = true;
+  if (!addWaypoints({globalToLocal(coord_transform_, w)})) {
+    response->success = false;
+    response->message = "Waypoint not set, waypoint buffer or command queue is full";
+    RCLCPP_ERROR(node_.get_logger(), "[%s]: %s", name_.c_str(), response->message.c_str());
+    return true;
+  }
+
+  response->message = "Waypoint set";
+  response->success = true;
+  RCLCPP_INFO(node_.get_logger(), "[%s]: %s", name_.c_str(), response->message.c_str());
   return true;
 }
 //}
 
 /* gpsPathCallback //{ */
-bool ControlInterface::gpsPathCallback(const std::shared_ptr<fog_msgs::srv::Path::Request> request, std::shared_ptr<fog_msgs::srv::Path::Response> response) {
+bool Vehicle::gpsPathCallback(const std::shared_ptr<fog_msgs::srv::Path::Request> request, std::shared_ptr<fog_msgs::srv::Path::Response> response) {
+  ScopedLatency scoped_latency(latency_->histograms[latency_stats_t::gps_path_service]);
 
-  if (!is_initialized_) {
-    response->success = false;
-    response->message = "Waypoints not set, not initialized";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
+  if (!admit(gps_path_guard_, *response)) {
     return true;
   }
 
-  if (!gettingPixhawkSensors()) {
+  if (request->path.poses.size() < 1) {
     response->success = false;
-    response->message = "Waypoints not set, missing Pixhawk sensors";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
+    response->message = "Waypoints not set, request is empty";
+    RCLCPP_ERROR(node_.get_logger(), "[%s]: %s", name_.c_str(), response->message.c_str());
     return true;
   }
 
-  if (request->path.poses.size() < 1) {
-    response->success = false;
-    response->message = "Waypoints not set, request is empty";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
+  const std::vector<double>   yaws = getYaw(request->path);
+  std::vector<gps_waypoint_t> global(request->path.poses.size());
+  for (size_t i = 0; i < request->path.poses.size(); i++) {
+    global[i].latitude  = request->path.poses[i].pose.position.x;
+    global[i].longitude = request->path.poses[i].pose.position.y;
+    global[i].altitude  = request->path.poses[i].pose.position.z;
+    global[i].yaw       = yaws[i];
+  }
+  // simplified in the local frame, the tolerances are in meters
+  std::vector<local_waypoint_t> waypoints = globalToLocal(coord_transform_, global);
+  simplify(waypoints);
+  RCLCPP_INFO(node_.get_logger(), "[%s]: Got %ld waypoints, %ld after simplification", name_.c_str(), request->path.poses.size(), waypoints.size());
+
+  if (!fitsBuffer(waypoints.size(), "Waypoints not set", *response)) {
     return true;
   }
 
   if (!stopPreviousMission()) {
     response->success = false;
     response->message = "Waypoints not set, previous mission cannot be aborted";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
+    RCLCPP_ERROR(node_.get_logger(), "[%s]: %s", name_.c_str(), response->message.c_str());
     return true;
   }
 
-  RCLCPP_INFO(this->get_logger(), "[%s]: Got %d waypoints", this->get_name(), request->path.poses.size());
-  for (size_t i = 0; i < request->path.poses.size(); i++) {
-    gps_waypoint_t w;
-    w.latitude  = request->path.poses[i].pose.position.x;
-    w.longitude = request->path.poses[i].pose.position.y;
-    w.altitude  = request->path.poses[i].pose.position.z;
-    w.yaw       = getYaw(request->path.poses[i].pose.orientation);
-    waypoint_buffer_.push_back(globalToLocal(coord_transform_, w));
-  }
-  motion_started_   = true;
+  if (!addWaypoints(std::move(waypoints))) {
+    response->success = false;
+    response->message = "Waypoints not set, waypoint buffer or command queue is full";
+    RCLCPP_ERROR(node_.get_logger(), "[%s]: %s", name_.c_str(), response->message.c_str());
+    return true;
+  }
   response->success = true;
   response->message = "Waypoints set";
   return true;
@@ -844,20 +1589,11 @@ bool ControlInterface::gpsPathCallback(const std::shared_ptr<fog_msgs::srv::Path
 //}
 
 /* waypointToLocalCallback (gps -> local frame) //{ */
-bool ControlInterface::waypointToLocalCallback(const std::shared_ptr<fog_msgs::srv::WaypointToLocal::Request> request,
-                                               std::shared_ptr<fog_msgs::srv::WaypointToLocal::Response>      response) {
+bool Vehicle::waypointToLocalCallback(const std::shared_ptr<fog_msgs::srv::WaypointToLocal::Request> request,
+                                      std::shared_ptr<fog_msgs::srv::WaypointToLocal::Response>      response) {
+  ScopedLatency scoped_latency(latency_->histograms[latency_stats_t::waypoint_to_local_service]);
 
-  if (!is_initialized_) {
-    response->success = false;
-    response->message = "Cannot transform coordinates, not initialized";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
-    return true;
-  }
-
-  if (!gettingPixhawkSensors()) {
-    response->success = false;
-    response->message = "Cannot transform coordinates, missing Pixhawk sensors";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
+  if (!admit(waypoint_to_local_guard_, *response)) {
     return true;
   }
 
@@ -879,380 +1615,1159 @@ bool ControlInterface::waypointToLocalCallback(const std::shared_ptr<fog_msgs::s
      << "]";
   response->message = ss.str();
   response->success = true;
-  RCLCPP_INFO(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
+  RCLCPP_INFO(node_.get_logger(), "[%s]: %s", name_.c_str(), response->message.c_str());
   return true;
 }
 //}
 
 /* pathToLocalCallback (gps -> local frame) //{ */
-bool ControlInterface::pathToLocalCallback(const std::shared_ptr<fog_msgs::srv::PathToLocal::Request> request,
-                                           std::shared_ptr<fog_msgs::srv::PathToLocal::Response>      response) {
+bool Vehicle::pathToLocalCallback(const std::shared_ptr<fog_msgs::srv::PathToLocal::Request> request,
+                                  std::shared_ptr<fog_msgs::srv::PathToLocal::Response>      response) {
+  ScopedLatency scoped_latency(latency_->histograms[latency_stats_t::path_to_local_service]);
 
-  if (!is_initialized_) {
-    response->success = false;
-    response->message = "Cannot transform coordinates, not initialized";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
+  if (!admit(path_to_local_guard_, *response)) {
     return true;
   }
 
-  if (!gettingPixhawkSensors()) {
-    response->success = false;
-    response->message = "Cannot transform coordinates, missing Pixhawk sensors";
-    RCLCPP_ERROR(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
-    return true;
+  const size_t        n = request->path.poses.size();
+  std::vector<double> lat(n), lon(n), east(n), north(n);
+  for (size_t i = 0; i < n; i++) {
+    lat[i] = request->path.poses[i].pose.position.x;
+    lon[i] = request->path.poses[i].pose.position.y;
+  }
+  coord_transform_->localFromGlobal(lat.data(), lon.data(), east.data(), north.data(), n);
+
+  nav_msgs::msg::Path local_path;
+  local_path.header.frame_id = "local";
+  local_path.header.stamp    = node_.get_clock()->now();
+  local_path.poses.resize(n);
+  for (size_t i = 0; i < n; i++) {
+    auto &pose_out       = local_path.poses[i].pose;
+    pose_out.position.x  = east[i];
+    pose_out.position.y  = north[i];
+    pose_out.position.z  = request->path.poses[i].pose.position.z;
+    pose_out.orientation = request->path.poses[i].pose.orientation;
+    RCLCPP_DEBUG(node_.get_logger(), "[%s]: Transformed GPS [%.7f, %.7f] into local: [%.2f, %.2f]", name_.c_str(), lat[i], lon[i], east[i], north[i]);
+  }
+  response->path = std::move(local_path);
+
+  std::stringstream ss;
+  ss << "Transformed " << n << " GPS poses into " << response->path.poses.size() << " local poses";
+  response->success = true;
+  response->message = ss.str();
+  RCLCPP_INFO(node_.get_logger(), "[%s]: %s", name_.c_str(), response->message.c_str());
+
+  return true;
+}
+//}
+
+/* controlRoutine //{ */
+void Vehicle::controlRoutine(void) {
+
+  if (is_initialized_) {
+    recordTick(last_control_tick_, control_update_rate_, latency_stats_t::control_period, latency_->control_overruns);
+    ScopedLatency scoped_latency(latency_->histograms[latency_stats_t::control_routine]);
+
+    updateLink();
+    updateSensorFreshness();
+    // a missed wakeup or MissionResult message delays the mission by one tick at most
+    missionRoutine();
+    publishDiagnostics();
+
+    if (vehicleConnected() && !gettingPixhawkSensors()) {
+      printSensorsStatus();
+    }
+  }
+}
+//}
+
+/* missionRoutine //{ */
+// runs on every control loop tick, on MissionResult progress and whenever a service or the waypoint stream queues a mission command
+void Vehicle::missionRoutine(void) {
+  processMissionCommands();
+
+  if (!vehicleConnected() || !gettingPixhawkSensors()) {
+    return;
   }
 
-  nav_msgs::msg::Path local_path;
+  RCLCPP_INFO_ONCE(node_.get_logger(), "[%s]: CONTROL INTERFACE IS READY", name_.c_str());
 
-  for (auto &pose : request->path.poses) {
-    geometry_msgs::msg::Point p_in = pose.pose.position;
+  if (!armed_) {
+    RCLCPP_INFO_THROTTLE(node_.get_logger(), *node_.get_clock(), 1000, "[%s]: Vehicle not armed", name_.c_str());
+    return;
+  }
 
-    gps_waypoint_t global;
-    global.latitude  = p_in.x;
-    global.longitude = p_in.y;
-    global.altitude  = p_in.z;
+  if (landed_) {
+    RCLCPP_INFO_THROTTLE(node_.get_logger(), *node_.get_clock(), 1000, "[%s]: Vehicle not airborne", name_.c_str());
+    return;
+  }
 
-    local_waypoint_t local = globalToLocal(coord_transform_, global);
+  /* handle motion //{ */
+  // in offboard control the motion is handled by offboardRoutine
+  if (motion_started_ && !offboard_control_) {
 
-    geometry_msgs::msg::Point p_out;
+    // drop waypoints which have already been reached from the uploaded window
+    updateMissionWindow();
 
-    p_out.x = local.x;
-    p_out.y = local.y;
-    p_out.z = local.z;
+    // create a new mission plan if there are unused points in buffer
+    if (waypoint_buffer_.size() > 0 && (mission_finished_ || missionWindowNeedsRefill())) {
+      publishDebugMarkers();
+      RCLCPP_INFO(node_.get_logger(), "[%s]: Waypoints to be visited: %ld", name_.c_str(), waypoint_buffer_.size() + mission_window_.size());
+      if (mission_finished_) {
+        commands_->pauseMission();
+      }
+      fillMissionWindow();
+      start_mission_ = true;
+    }
 
-    std::stringstream ss;
-    ss << "Transformed GPS [" << global.latitude << ", " << global.longitude << "] into local: [" << p_out.x << ", " << p_out.y << "]";
-    response->message = ss.str();
-    response->success = true;
-    RCLCPP_INFO(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
+    // upload and execute new mission
+    if (start_mission_ && mission_plan_.mission_items.size() > 0) {
+      executeMission();
+      mission_finished_ = false;
+      start_mission_    = false;
+    }
 
-    geometry_msgs::msg::PoseStamped p_stamped;
-    p_stamped.pose.position    = p_out;
-    p_stamped.pose.orientation = pose.pose.orientation;
-    local_path.poses.push_back(p_stamped);
-    local_path.header.frame_id = "local";
-    local_path.header.stamp    = this->get_clock()->now();
+    // stop if final goal is reached
+    if (mission_finished_) {
+      RCLCPP_INFO(node_.get_logger(), "[%s]: All waypoints have been visited", name_.c_str());
+      motion_started_ = false;
+    }
   }
-  std::stringstream ss;
-  ss << "Transformed " << request->path.poses.size() << " GPS poses into " << response->path.poses.size() << " local poses";
-  response->path    = local_path;
-  response->success = true;
-  response->message = ss.str();
-  RCLCPP_INFO(this->get_logger(), "[%s]: %s", this->get_name(), response->message.c_str());
-
-  return true;
+  //}
 }
 //}
 
-/* controlRoutine //{ */
-void ControlInterface::controlRoutine(void) {
+/* offboardRoutine //{ */
+void Vehicle::offboardRoutine(void) {
 
-  if (is_initialized_) {
-    publishDiagnostics();
+  if (!is_initialized_) {
+    return;
+  }
+  recordTick(last_offboard_tick_, offboard_setpoint_rate_, latency_stats_t::offboard_period, latency_->offboard_overruns);
+  ScopedLatency scoped_latency(latency_->histograms[latency_stats_t::offboard_routine]);
 
-    if (gettingPixhawkSensors()) {
+  if (!gettingPixhawkSensors()) {
+    return;
+  }
 
-      RCLCPP_INFO_ONCE(this->get_logger(), "[%s]: CONTROL INTERFACE IS READY", this->get_name());
+  // waypoints are picked up at the setpoint rate, not at the control loop rate
+  processMissionCommands();
 
-      if (!armed_) {
-        RCLCPP_INFO_THROTTLE(this->get_logger(), *this->get_clock(), 1000, "[%s]: Vehicle not armed", this->get_name());
-        return;
-      }
+  if (!armed_ || landed_) {
+    offboard_setpoint_valid_ = false;
+    offboard_setpoints_sent_ = 0;
+    return;
+  }
 
-      if (landed_) {
-        RCLCPP_INFO_THROTTLE(this->get_logger(), *this->get_clock(), 1000, "[%s]: Vehicle not airborne", this->get_name());
-        return;
+  const auto            odom = odometry_.load();
+  const Eigen::Vector3d vehicle_position(odom.pos[0], odom.pos[1], odom.pos[2]);
+  const bool            following = offboard_enabled_;
+
+  // until the vehicle follows the setpoints, keep them at its position so that the switch into offboard does not move it
+  // this holds after the motion has started too, PX4 may reject the first mode requests and must not switch into a setpoint far away
+  if (!offboard_setpoint_valid_ || !following) {
+    offboard_position_       = vehicle_position;
+    offboard_yaw_            = getYaw(odom.ori);
+    offboard_setpoint_valid_ = true;
+  }
+
+  if (motion_started_ && waypoint_buffer_.size() > 0) {
+    mission_finished_ = false;
+    desired_pose_.store(waypoint_buffer_.front());
+  }
+
+  if (motion_started_ && waypoint_buffer_.size() > 0 && following) {
+    // move the setpoint towards the next waypoint at the target velocity, local ENU -> PX4 NED
+    const local_waypoint_t &goal = waypoint_buffer_.front();
+    const Eigen::Vector3d   goal_position(goal.y, goal.x, -goal.z);
+    const Eigen::Vector3d   diff     = goal_position - offboard_position_;
+    const double            step     = std::isfinite(target_velocity_) && target_velocity_ > 0 ? target_velocity_ / offboard_setpoint_rate_ : diff.norm();
+    const double            distance = diff.norm();
+    offboard_position_               = distance > step ? Eigen::Vector3d(offboard_position_ + diff * (step / distance)) : goal_position;
+    offboard_yaw_                    = -(goal.yaw + yaw_offset_correction_);  // same convention as the mission items
+
+    if (offboard_position_ == goal_position && (goal_position - vehicle_position).norm() < waypoint_acceptance_radius_) {
+      waypoint_buffer_.pop_front();
+      releaseBuffer(1);
+      if (waypoint_buffer_.empty()) {
+        RCLCPP_INFO(node_.get_logger(), "[%s]: All waypoints have been visited", name_.c_str());
+        mission_finished_ = true;
+        motion_started_   = false;
       }
+    }
+  }
 
-      /* handle motion //{ */
-      if (motion_started_) {
-
-        // create a new mission plan if there are unused points in buffer
-        if (waypoint_buffer_.size() > 0 && mission_finished_) {
-          publishDebugMarkers();
-          RCLCPP_INFO(this->get_logger(), "[%s]: Waypoints to be visited: %ld", this->get_name(), waypoint_buffer_.size());
-          mission_->pause_mission();
-          mission_plan_.mission_items.clear();
-
-          addToMission(waypoint_buffer_.front());
-          desired_pose_ = Eigen::Vector4d(waypoint_buffer_.front().x, waypoint_buffer_.front().y, waypoint_buffer_.front().z, waypoint_buffer_.front().yaw);
-          waypoint_buffer_.pop_front();
+  publishOffboardSetpoint();
 
-          /* for (auto &w : waypoint_buffer_) { */
-          /*   addToMission(w); */
-          /* } */
-          /* waypoint_buffer_.clear(); */
+  // PX4 accepts the switch only after it has been receiving setpoints for a while, repeat the request once per second until it does
+  const unsigned request_period = std::max(1u, static_cast<unsigned>(offboard_setpoint_rate_));
+  if (motion_started_ && !offboard_enabled_ && offboard_setpoints_sent_ >= 10 && (offboard_setpoints_sent_ - 10) % request_period == 0) {
+    requestOffboardMode();
+  }
+}
+//}
 
-          start_mission_ = true;
-        }
+/* gettingPixhawkSensors //{ */
+// true only while every telemetry topic is fresh, the node must not command the vehicle from a stale position
+bool Vehicle::gettingPixhawkSensors() {
+  const auto now = std::chrono::steady_clock::now();
+  for (const auto &topic : sensors_.topics) {
+    if (!topic.fresh(now)) {
+      return false;
+    }
+  }
+  return true;
+}
+//}
 
-        // upload and execute new mission
-        if (start_mission_ && mission_plan_.mission_items.size() > 0) {
-          uploadMission();
-          startMission();
-          mission_finished_ = false;
-          start_mission_    = false;
-        }
+/* sensorReceived //{ */
+// called by the telemetry callbacks, which share one callback group, so the last sensor to arrive sees all the others
+void Vehicle::sensorReceived(const sensor_stats_t::id_t id) {
+  if (sensors_.topics[id].received(std::chrono::steady_clock::now())) {
+    gate_.set(PreconditionGate::sensors, gettingPixhawkSensors());
+  }
+}
+//}
 
-        // stop if final goal is reached
-        if (mission_finished_) {
-          RCLCPP_INFO(this->get_logger(), "[%s]: All waypoints have been visited", this->get_name());
-          motion_started_ = false;
-        }
+/* updateSensorFreshness //{ */
+// called by the control loop, a topic going stale is only noticed here, the callbacks notice when it comes back
+void Vehicle::updateSensorFreshness() {
+  const bool fresh = gettingPixhawkSensors();
+  gate_.set(PreconditionGate::sensors, fresh);
+  if (sensors_fresh_ && !fresh) {
+    const auto now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < sensor_stats_t::count; i++) {
+      const auto &topic = sensors_.topics[i];
+      if (!topic.fresh(now)) {
+        RCLCPP_ERROR(node_.get_logger(), "[%s]: Pixhawk %s is stale, last message %.2f s ago (timeout %.2f s)", name_.c_str(), sensor_stats_t::names[i],
+                     topic.age(now), topic.timeout());
       }
-      //}
-
-    } else {
-      printSensorsStatus();
     }
+  } else if (!sensors_fresh_ && fresh) {
+    RCLCPP_INFO(node_.get_logger(), "[%s]: All Pixhawk sensors are fresh", name_.c_str());
   }
+  sensors_fresh_ = fresh;
 }
 //}
 
-/* gettingPixhawkSensors //{ */
-bool ControlInterface::gettingPixhawkSensors() {
-  return getting_gps_ && getting_pixhawk_odom_ && getting_control_mode_ && getting_landed_info_;
+/* admit //{ */
+// checks the preconditions of a service, a rejected request gets the precomputed message and is logged only if the gate allows it
+template <class ResponseT>
+bool Vehicle::admit(const PreconditionGate::guard_t &guard, ResponseT &response) {
+  const auto failed = gate_.check(guard.required);
+  if (failed == PreconditionGate::condition_count) {
+    return true;
+  }
+  response.success = false;
+  response.message = guard.messages[failed];
+  if (gate_.reject(failed)) {
+    RCLCPP_ERROR(node_.get_logger(), "[%s]: %s (%lu rejections so far)", name_.c_str(), response.message.c_str(), gate_.rejections(failed));
+  }
+  return false;
 }
 //}
 
 /* printSensorsStatus //{ */
-void ControlInterface::printSensorsStatus() {
-  RCLCPP_INFO_THROTTLE(this->get_logger(), *this->get_clock(), 1000, "[%s]: GPS:%s, ODOM:%s, CTRL:%s, LAND:%s", this->get_name(),
-                       getting_gps_ ? "TRUE" : "FALSE", getting_pixhawk_odom_ ? "TRUE" : "FALSE", getting_control_mode_ ? "TRUE" : "FALSE",
-                       getting_landed_info_ ? "TRUE" : "FALSE");
+void Vehicle::printSensorsStatus() {
+  const auto  now    = std::chrono::steady_clock::now();
+  const auto &topics = sensors_.topics;
+  RCLCPP_INFO_THROTTLE(node_.get_logger(), *node_.get_clock(), 1000, "[%s]: GPS:%s, ODOM:%s, CTRL:%s, LAND:%s", name_.c_str(),
+                       topics[sensor_stats_t::gps].fresh(now) ? "TRUE" : "FALSE", topics[sensor_stats_t::odometry].fresh(now) ? "TRUE" : "FALSE",
+                       topics[sensor_stats_t::control_mode].fresh(now) ? "TRUE" : "FALSE",
+                       topics[sensor_stats_t::land_detected].fresh(now) ? "TRUE" : "FALSE");
 }
 //}
 
 /* publishDiagnostics //{ */
-void ControlInterface::publishDiagnostics() {
+// published only when the state changes, and once per heartbeat period so that a late subscriber or a lost message is caught up
+void Vehicle::publishDiagnostics() {
+  const auto     now                  = std::chrono::steady_clock::now();
+  const bool     getting_odom         = sensors_.topics[sensor_stats_t::odometry].fresh(now);
+  const bool     getting_control_mode = sensors_.topics[sensor_stats_t::control_mode].fresh(now);
+  const bool     getting_land_sensor  = sensors_.topics[sensor_stats_t::land_detected].fresh(now);
+  const uint32_t flags = (armed_ ? flight_record_t::armed : 0) | (!landed_ ? flight_record_t::airborne : 0) | (motion_started_ ? flight_record_t::moving : 0) |
+                         (mission_finished_ ? flight_record_t::mission_finished : 0) | (getting_odom ? flight_record_t::getting_odom : 0) |
+                         (getting_control_mode ? flight_record_t::getting_control : 0) | (getting_land_sensor ? flight_record_t::getting_land : 0);
+  const size_t buffered = waypoint_buffer_.size();
+
+  // state transitions go to the flight recorder, the buffer level is recorded with them but does not make a record on its own
+  if (recorder_ != nullptr && flags != diagnostics_flags_) {
+    recorder_->record(flight_record_t::state, system_id_, int32_t(flags), {double(link_state_.load()), double(buffered)});
+  }
+
+  const bool heartbeat = std::chrono::duration<double>(now - diagnostics_stamp_).count() >= diagnostics_heartbeat_period_;
+  if (!heartbeat && flags == diagnostics_flags_ && buffered == diagnostics_buffered_) {
+    return;
+  }
+  diagnostics_flags_    = flags;
+  diagnostics_buffered_ = buffered;
+  diagnostics_stamp_    = now;
+
   fog_msgs::msg::ControlInterfaceDiagnostics msg;
-  msg.header.stamp           = this->get_clock()->now();
+  msg.header.stamp           = node_.get_clock()->now();
   msg.header.frame_id        = world_frame_;
   msg.armed                  = armed_;
   msg.airborne               = !landed_;
   msg.moving                 = motion_started_;
   msg.mission_finished       = mission_finished_;
-  msg.buffered_mission_items = waypoint_buffer_.size();
-  /* msg.getting_gps            = getting_gps_; */
-  msg.getting_odom         = getting_pixhawk_odom_;
-  msg.getting_control_mode = getting_control_mode_;
-  msg.getting_land_sensor  = getting_landed_info_;
+  msg.buffered_mission_items = buffered;
+  /* msg.getting_gps            = sensors_.topics[sensor_stats_t::gps].fresh(now); */
+  msg.getting_odom         = getting_odom;
+  msg.getting_control_mode = getting_control_mode;
+  msg.getting_land_sensor  = getting_land_sensor;
   diagnostics_publisher_->publish(msg);
 }
 //}
 
-/* takeoff //{ */
-bool ControlInterface::takeoff() {
-  auto result = action_->set_takeoff_altitude(takeoff_height_);
-  if (result != mavsdk::Action::Result::Success) {
-    RCLCPP_ERROR(this->get_logger(), "[%s]: Failed to set takeoff height %.2f", this->get_name(), takeoff_height_);
-    return false;
+/* recordTick //{ */
+// called at the start of a timer callback, records the interval since the previous tick
+void Vehicle::recordTick(std::chrono::steady_clock::time_point &last_tick, const double rate, const latency_stats_t::id_t period,
+                         std::atomic<uint64_t> &overruns) {
+  const auto now = std::chrono::steady_clock::now();
+  if (last_tick != std::chrono::steady_clock::time_point()) {
+    const auto interval = now - last_tick;
+    latency_->histograms[period].record(interval);
+    if (std::chrono::duration<double>(interval).count() > 1.5 / rate) {
+      overruns++;
+    }
+  }
+  last_tick = now;
+}
+//}
+
+/* publishLatency //{ */
+void Vehicle::publishLatency() {
+  diagnostic_msgs::msg::DiagnosticArray msg;
+  msg.header.stamp = node_.get_clock()->now();
+
+  diagnostic_msgs::msg::DiagnosticStatus status;
+  status.name        = name_ + "/latency";
+  status.hardware_id = uav_name_;
+  status.level       = diagnostic_msgs::msg::DiagnosticStatus::OK;
+  if (latency_->control_overruns > 0 || latency_->offboard_overruns > 0) {
+    status.level   = diagnostic_msgs::msg::DiagnosticStatus::WARN;
+    status.message = "Timer overruns";
+  }
+
+  const auto add_value = [&status](const std::string &key, const std::string &value) {
+    diagnostic_msgs::msg::KeyValue kv;
+    kv.key   = key;
+    kv.value = value;
+    status.values.push_back(kv);
+  };
+
+  add_value("control_overruns", std::to_string(latency_->control_overruns));
+  add_value("offboard_overruns", std::to_string(latency_->offboard_overruns));
+  add_value("mission_uploads", std::to_string(latency_->mission_uploads));
+  add_value("mission_reuses", std::to_string(latency_->mission_reuses));
+  add_value("path.points", std::to_string(latency_->path_points));
+  add_value("path.dropped", std::to_string(latency_->path_dropped));
+  add_value("waypoint_buffer.size", std::to_string(waypoint_buffer_.size()));
+  add_value("waypoint_buffer.capacity", std::to_string(waypoint_buffer_capacity_));
+  add_value("waypoint_buffer.high_water", std::to_string(buffer_high_water_));
+  add_value("waypoint_buffer.rejected", std::to_string(buffer_rejections_));
+  for (size_t i = 0; i < PreconditionGate::condition_count; i++) {
+    add_value(std::string("rejected.") + PreconditionGate::keys[i], std::to_string(gate_.rejections(PreconditionGate::condition_t(i))));
+  }
+  for (size_t i = 0; i < latency_stats_t::count; i++) {
+    const auto        snapshot = latency_->histograms[i].snapshot();
+    const std::string name     = latency_stats_t::names[i];
+    if (snapshot.count == 0) {
+      continue;
+    }
+    add_value(name + ".count", std::to_string(snapshot.count));
+    add_value(name + ".mean_us", std::to_string(uint64_t(snapshot.meanUs())));
+    add_value(name + ".p50_us", std::to_string(snapshot.quantileUs(0.5)));
+    add_value(name + ".p99_us", std::to_string(snapshot.quantileUs(0.99)));
+    add_value(name + ".max_us", std::to_string(snapshot.max_us));
+
+    // counts of the power-of-two microsecond buckets up to the last non-empty one
+    size_t last = 0;
+    for (size_t b = 0; b < LatencyHistogram::bucket_count; b++) {
+      if (snapshot.buckets[b] > 0) {
+        last = b;
+      }
+    }
+    std::stringstream ss;
+    for (size_t b = 0; b <= last; b++) {
+      ss << (b > 0 ? "," : "") << snapshot.buckets[b];
+    }
+    add_value(name + ".buckets", ss.str());
+  }
+
+  msg.status.push_back(status);
+
+  // measured rate and age of the telemetry topics, to tune the bridge rates and spot a starved link
+  diagnostic_msgs::msg::DiagnosticStatus sensors;
+  sensors.name        = name_ + "/sensors";
+  sensors.hardware_id = uav_name_;
+  sensors.level       = diagnostic_msgs::msg::DiagnosticStatus::OK;
+  const auto now      = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < sensor_stats_t::count; i++) {
+    const auto       &topic = sensors_.topics[i];
+    const std::string name  = sensor_stats_t::names[i];
+    if (!topic.fresh(now)) {
+      sensors.level   = diagnostic_msgs::msg::DiagnosticStatus::ERROR;
+      sensors.message = sensors.message.empty() ? "Stale: " + name : sensors.message + ", " + name;
+    }
+    std::stringstream rate, age;
+    rate << std::fixed << std::setprecision(1) << topic.rate(now);
+    age << std::fixed << std::setprecision(3) << topic.age(now);
+    diagnostic_msgs::msg::KeyValue kv;
+    kv.key   = name + ".rate_hz";
+    kv.value = rate.str();
+    sensors.values.push_back(kv);
+    kv.key   = name + ".age_s";
+    kv.value = age.str();
+    sensors.values.push_back(kv);
+    kv.key   = name + ".count";
+    kv.value = std::to_string(topic.count());
+    sensors.values.push_back(kv);
+  }
+  msg.status.push_back(sensors);
+
+  // MAVLink traffic of the vehicle, the rates are averaged over the export period
+  diagnostic_msgs::msg::DiagnosticStatus link;
+  link.name        = name_ + "/link";
+  link.hardware_id = uav_name_;
+  link.level       = link_state_ == link_state_t::connected ? diagnostic_msgs::msg::DiagnosticStatus::OK : diagnostic_msgs::msg::DiagnosticStatus::ERROR;
+  link.message     = link_state_ == link_state_t::connected ? "" : "Vehicle not connected";
+  const uint64_t received = link_.received;
+  const uint64_t sent     = link_.sent;
+  const double   interval = std::chrono::duration<double>(now - link_rate_stamp_).count();
+  const bool     sampled  = link_rate_stamp_ != std::chrono::steady_clock::time_point() && interval > 0.0;
+  std::stringstream rx_rate, tx_rate;
+  rx_rate << std::fixed << std::setprecision(1) << (sampled ? (received - link_rate_received_) / interval : 0.0);
+  tx_rate << std::fixed << std::setprecision(1) << (sampled ? (sent - link_rate_sent_) / interval : 0.0);
+  link_rate_received_ = received;
+  link_rate_sent_     = sent;
+  link_rate_stamp_    = now;
+
+  const auto upload         = latency_->histograms[latency_stats_t::mission_upload].snapshot();
+  const auto add_link_value = [&link](const std::string &key, const std::string &value) {
+    diagnostic_msgs::msg::KeyValue kv;
+    kv.key   = key;
+    kv.value = value;
+    link.values.push_back(kv);
+  };
+  add_link_value("rx_rate_hz", rx_rate.str());
+  add_link_value("tx_rate_hz", tx_rate.str());
+  add_link_value("received", std::to_string(received));
+  add_link_value("sent", std::to_string(sent));
+  add_link_value("lost", std::to_string(link_.lost));
+  add_link_value("command_retries", std::to_string(link_.command_retries));
+  add_link_value("mission_items_sent", std::to_string(link_.mission_items));
+  add_link_value("mission_uploads", std::to_string(upload.count));
+  add_link_value("mission_upload.mean_ms", std::to_string(uint64_t(upload.meanUs() / 1000)));
+  add_link_value("mission_upload.p99_ms", std::to_string(upload.quantileUs(0.99) / 1000));
+  add_link_value("mission_upload.max_ms", std::to_string(upload.max_us / 1000));
+  msg.status.push_back(link);
+
+  latency_publisher_->publish(msg);
+}
+//}
+
+/* latencyReport //{ */
+std::string Vehicle::latencyReport() {
+  std::stringstream ss;
+  ss << "control overruns: " << latency_->control_overruns << ", offboard overruns: " << latency_->offboard_overruns;
+  ss << "\nmission uploads: " << latency_->mission_uploads << ", reused plans: " << latency_->mission_reuses;
+  ss << "\npath waypoints: " << latency_->path_points << ", dropped by simplification: " << latency_->path_dropped;
+  ss << "\nwaypoint buffer: " << waypoint_buffer_.size() << " of " << waypoint_buffer_capacity_ << ", high water " << buffer_high_water_ << ", rejected "
+     << buffer_rejections_;
+  ss << "\nMAVLink: received " << link_.received << ", sent " << link_.sent << ", lost " << link_.lost << ", command retries " << link_.command_retries
+     << ", mission items sent " << link_.mission_items;
+  const auto now = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < sensor_stats_t::count; i++) {
+    const auto &topic = sensors_.topics[i];
+    ss << "\n" << sensor_stats_t::names[i] << ": " << std::fixed << std::setprecision(1) << topic.rate(now) << " Hz, age " << std::setprecision(3)
+       << topic.age(now) << " s, count " << topic.count() << (topic.fresh(now) ? "" : ", STALE");
+  }
+  ss << std::defaultfloat;
+  ss << "\nrejected requests:";
+  for (size_t i = 0; i < PreconditionGate::condition_count; i++) {
+    ss << " " << PreconditionGate::keys[i] << ":" << gate_.rejections(PreconditionGate::condition_t(i));
+  }
+  for (size_t i = 0; i < latency_stats_t::count; i++) {
+    const auto snapshot = latency_->histograms[i].snapshot();
+    ss << "\n" << latency_stats_t::names[i] << ": count " << snapshot.count;
+    if (snapshot.count == 0) {
+      continue;
+    }
+    ss << ", mean " << uint64_t(snapshot.meanUs()) << " us, p50 " << snapshot.quantileUs(0.5) << " us, p99 " << snapshot.quantileUs(0.99) << " us, max "
+       << snapshot.max_us << " us, buckets [us]:";
+    for (size_t b = 0; b < LatencyHistogram::bucket_count; b++) {
+      if (snapshot.buckets[b] > 0) {
+        ss << " <" << LatencyHistogram::bucketUpperUs(b) << ":" << snapshot.buckets[b];
+      }
+    }
   }
+  return ss.str();
+}
+//}
+
+/* latencyDumpCallback //{ */
+bool Vehicle::latencyDumpCallback([[maybe_unused]] const std::shared_ptr<std_srvs::srv::Trigger::Request> request,
+                                  std::shared_ptr<std_srvs::srv::Trigger::Response>                       response) {
+  response->success = true;
+  response->message = latencyReport();
+  RCLCPP_INFO(node_.get_logger(), "[%s]: Latency statistics:\n%s", name_.c_str(), response->message.c_str());
+  return true;
+}
+//}
+
+/* latencyResetCallback //{ */
+bool Vehicle::latencyResetCallback([[maybe_unused]] const std::shared_ptr<std_srvs::srv::Trigger::Request> request,
+                                   std::shared_ptr<std_srvs::srv::Trigger::Response>                       response) {
+  latency_->reset();
+  gate_.resetRejections();
+  link_.reset();
+  link_rate_stamp_   = std::chrono::steady_clock::time_point();
+  buffer_high_water_ = waypoint_buffer_.size();
+  buffer_rejections_ = 0;
+  response->success = true;
+  response->message = "Latency statistics and rejection counters reset";
+  RCLCPP_INFO(node_.get_logger(), "[%s]: %s", name_.c_str(), response->message.c_str());
+  return true;
+}
+//}
 
+/* takeoff //{ */
+bool Vehicle::takeoff() {
   if (reset_octomap_before_takeoff_) {
     auto reset_srv   = std::make_shared<std_srvs::srv::Empty::Request>();
     auto call_result = octomap_reset_client_->async_send_request(reset_srv);
-    RCLCPP_INFO(this->get_logger(), "[%s]: Resetting octomap server", this->get_name());
+    RCLCPP_INFO(node_.get_logger(), "[%s]: Resetting octomap server", name_.c_str());
   }
 
-  action_->takeoff();
-  if (result != mavsdk::Action::Result::Success) {
-    RCLCPP_ERROR(this->get_logger(), "[%s]: Takeoff failed", this->get_name());
+  auto result = commands_->takeoff().get();
+  if (!result.success) {
+    RCLCPP_ERROR(node_.get_logger(), "[%s]: Takeoff failed", name_.c_str());
     return false;
   }
 
+  auto             odom = odometry_.load();
   local_waypoint_t current_goal;
-  current_goal.x   = pos_[1];
-  current_goal.y   = pos_[0];
+  current_goal.x   = odom.pos[1];
+  current_goal.y   = odom.pos[0];
   current_goal.z   = takeoff_height_;
-  current_goal.yaw = getYaw(ori_) - yaw_offset_correction_;
-  waypoint_buffer_.push_back(current_goal);
-  motion_started_ = true;
-  RCLCPP_INFO(this->get_logger(), "[%s]: Taking off", this->get_name());
+  current_goal.yaw = getYaw(odom.ori) - yaw_offset_correction_;
+  if (!addWaypoints({current_goal})) {
+    RCLCPP_ERROR(node_.get_logger(), "[%s]: Takeoff goal not set, command queue is full", name_.c_str());
+    return false;
+  }
+  RCLCPP_INFO(node_.get_logger(), "[%s]: Taking off", name_.c_str());
   return true;
 }
 //}
 
 /* land //{ */
-bool ControlInterface::land() {
-  auto result = action_->land();
-  if (result != mavsdk::Action::Result::Success) {
-    RCLCPP_ERROR(this->get_logger(), "[%s]: Landing failed", this->get_name());
+bool Vehicle::land() {
+  auto result = commands_->land().get();
+  if (!result.success) {
+    RCLCPP_ERROR(node_.get_logger(), "[%s]: Landing failed", name_.c_str());
     return false;
   }
-  RCLCPP_INFO(this->get_logger(), "[%s]: Landing", this->get_name());
+  RCLCPP_INFO(node_.get_logger(), "[%s]: Landing", name_.c_str());
   return true;
 }
 //}
 
 /* startMission //{ */
-bool ControlInterface::startMission() {
-  auto result = mission_->start_mission();
-  if (result != mavsdk::Mission::Result::Success) {
-    RCLCPP_ERROR(this->get_logger(), "[%s]: Mission start rejected", this->get_name());
+void Vehicle::startMission() {
+  // the result is reported by the command worker, the control loop does not wait for it
+  commands_->startMission();
+}
+//}
+
+/* uploadMission //{ */
+void Vehicle::uploadMission() {
+  vehicle_plan_.clear();
+  vehicle_plan_seq_.clear();
+  int seq = 0;
+  for (const auto &p : mission_window_items_) {
+    vehicle_plan_.push_back(p.hash);
+    vehicle_plan_seq_.push_back(seq);
+    seq += mavlinkItemCount(p.item);
+  }
+  vehicle_plan_upload_ = commands_->uploadMission(mission_plan_).share();
+  latency_->mission_uploads++;
+}
+//}
+
+/* executeMission //{ */
+// uploads the mission plan and starts it, unless the vehicle already has the plan, then it only moves the vehicle to the first new item
+void Vehicle::executeMission() {
+  const int offset = vehiclePlanOffset();
+  if (offset < 0) {
+    replaced_mission_instance_ = mission_result_instance_;
+    mission_seq_reached_       = -1;
+    mission_window_offset_     = 0;
+    uploadMission();
+    startMission();
+    if (recorder_ != nullptr) {
+      recorder_->record(flight_record_t::mission_upload, system_id_, int32_t(mission_plan_.mission_items.size()), {0.0, 0.0});
+    }
+    return;
+  }
+
+  // the same mission instance goes on, items of the window which the vehicle has already reached are dropped by updateMissionWindow
+  mission_window_offset_ = offset;
+  if (offset > mission_seq_reached_ + 1) {
+    commands_->setCurrentMissionItem(offset);
+  }
+  startMission();
+  latency_->mission_reuses++;
+  if (recorder_ != nullptr) {
+    recorder_->record(flight_record_t::mission_upload, system_id_, int32_t(mission_plan_.mission_items.size()),
+                      {1.0, double(std::max(offset, mission_seq_reached_ + 1))});
+  }
+  RCLCPP_INFO(node_.get_logger(), "[%s]: Mission plan already on the vehicle, continuing from item %d", name_.c_str(),
+              std::max(offset, mission_seq_reached_ + 1));
+}
+//}
+
+/* vehiclePlanOffset //{ */
+// index of the item of the vehicle's plan from which the rest of it equals mission_plan_, -1 if the plan has to be uploaded
+int Vehicle::vehiclePlanOffset() {
+  if (vehicle_plan_.empty() || !vehicle_plan_upload_.valid()) {
+    return -1;
+  }
+  // an upload which has not been acknowledged yet may still fail
+  if (vehicle_plan_upload_.wait_for(std::chrono::seconds(0)) != std::future_status::ready || !vehicle_plan_upload_.get().success) {
+    return -1;
+  }
+  if (mission_window_items_.size() > vehicle_plan_.size()) {
+    return -1;
+  }
+  const size_t offset = vehicle_plan_.size() - mission_window_items_.size();
+  for (size_t i = 0; i < mission_window_items_.size(); i++) {
+    if (vehicle_plan_[offset + i] != mission_window_items_[i].hash) {
+      return -1;
+    }
+  }
+  return int(offset);
+}
+//}
+
+/* wakeControlLoop //{ */
+// one wakeup on its way is enough, the control loop drains all queued mission commands at once
+void Vehicle::wakeControlLoop() {
+  if (wakeup_pending_.exchange(true)) {
+    return;
+  }
+  wakeup_requested_ = std::chrono::steady_clock::now().time_since_epoch().count();
+  wakeup_publisher_->publish(std_msgs::msg::Empty());
+}
+//}
+
+/* stopPreviousMission //{ */
+bool Vehicle::stopPreviousMission() {
+
+  // the control loop owns the mission, it clears the buffer and pauses the vehicle once it picks up the request
+  mission_command_t command;
+  command.type    = mission_command_t::type_t::stop;
+  command.stopped = std::make_shared<std::promise<std::future<CommandChannel::result_t>>>();
+  auto stopped    = command.stopped->get_future();
+
+  if (!mission_commands_.push(std::move(command))) {
+    RCLCPP_ERROR(node_.get_logger(), "[%s]: Previous mission cannot be stopped, command queue is full", name_.c_str());
     return false;
   }
-  RCLCPP_INFO(this->get_logger(), "[%s]: Mission started", this->get_name());
+  wakeControlLoop();
+
+  if (stopped.wait_for(std::chrono::duration<double>(command_timeout_)) != std::future_status::ready) {
+    RCLCPP_ERROR(node_.get_logger(), "[%s]: Previous mission cannot be stopped, control loop not responding", name_.c_str());
+    return false;
+  }
+
+  auto result = stopped.get().get();
+  if (!result.success) {
+    RCLCPP_ERROR(node_.get_logger(), "[%s]: Previous mission cannot be stopped", name_.c_str());
+    return false;
+  }
+  RCLCPP_INFO(node_.get_logger(), "[%s]: Previous mission stopped", name_.c_str());
   return true;
 }
 //}
 
-/* uploadMission //{ */
-bool ControlInterface::uploadMission() {
+/* simplify //{ */
+// a dense path then neither fills the waypoint buffer nor makes the mission uploads longer
+void Vehicle::simplify(std::vector<local_waypoint_t> &waypoints) {
+  latency_->path_points += waypoints.size();
+  latency_->path_dropped += simplifyPath(waypoints, simplify_position_tolerance_, simplify_yaw_tolerance_);
+}
+//}
 
-  auto result = mission_->upload_mission(mission_plan_);
-  if (result != mavsdk::Mission::Result::Success) {
-    RCLCPP_ERROR(this->get_logger(), "[%s]: Mission upload failed", this->get_name());
+/* addWaypoints //{ */
+// the room in the waypoint buffer is reserved here, so the control loop never has to drop waypoints of an accepted request
+bool Vehicle::addWaypoints(std::vector<local_waypoint_t> &&waypoints) {
+  const size_t count = waypoints.size();
+  if (count == 0 || reserveBuffer(count, false) == 0) {
+    buffer_rejections_ += count;
     return false;
   }
-  RCLCPP_INFO(this->get_logger(), "[%s]: Mission uploaded", this->get_name());
-
+  const local_waypoint_t last = waypoints.back();
+  mission_command_t      command;
+  command.type      = mission_command_t::type_t::append;
+  command.waypoints = std::move(waypoints);
+  if (!mission_commands_.push(std::move(command))) {
+    releaseBuffer(count);
+    return false;
+  }
+  wakeControlLoop();
+  if (recorder_ != nullptr) {
+    recorder_->record(flight_record_t::waypoints_queued, system_id_, int32_t(count), {last.x, last.y, last.z, last.yaw});
+  }
   return true;
 }
 //}
 
-/* stopPreviousMission //{ */
-bool ControlInterface::stopPreviousMission() {
+/* fitsBuffer //{ */
+// rejects a request which could not fit into the waypoint buffer even after the previous mission is stopped
+template <class ResponseT>
+bool Vehicle::fitsBuffer(const size_t count, const std::string &action, ResponseT &response) {
+  if (count <= static_cast<size_t>(waypoint_buffer_capacity_)) {
+    return true;
+  }
+  buffer_rejections_ += count;
+  response.success = false;
+  response.message = action + ", waypoint buffer full (" + std::to_string(count) + " waypoints, capacity " + std::to_string(waypoint_buffer_capacity_) + ")";
+  RCLCPP_ERROR(node_.get_logger(), "[%s]: %s", name_.c_str(), response.message.c_str());
+  return false;
+}
+//}
+
+/* reserveBuffer //{ */
+// takes room for count waypoints, or for as many as are free if partial is set, returns the number of reserved waypoints
+size_t Vehicle::reserveBuffer(const size_t count, const bool partial) {
+  int64_t credit = buffer_credit_.load();
+  while (true) {
+    const int64_t granted = std::min(credit, static_cast<int64_t>(count));
+    if (granted <= 0 || (!partial && granted < static_cast<int64_t>(count))) {
+      return 0;
+    }
+    if (buffer_credit_.compare_exchange_weak(credit, credit - granted)) {
+      return static_cast<size_t>(granted);
+    }
+  }
+}
+//}
+
+/* releaseBuffer //{ */
+// called by the control loop for every waypoint which leaves the buffer
+void Vehicle::releaseBuffer(const size_t count) {
+  buffer_credit_ += count;
+}
+//}
+
+/* recordBufferSize //{ */
+void Vehicle::recordBufferSize() {
+  if (waypoint_buffer_.size() > buffer_high_water_) {
+    buffer_high_water_ = waypoint_buffer_.size();
+  }
+}
+//}
+
+/* processMissionCommands //{ */
+void Vehicle::processMissionCommands() {
+  mission_command_t command;
+  while (mission_commands_.pop(command)) {
+    switch (command.type) {
+      case mission_command_t::type_t::append: {
+        // reserved by addWaypoints, always fits
+        waypoint_buffer_.append(command.waypoints.begin(), command.waypoints.end());
+        recordBufferSize();
+        motion_started_ = true;
+        break;
+      }
+      case mission_command_t::type_t::splice: {
+        spliceWaypoints(command.waypoints);
+        break;
+      }
+      case mission_command_t::type_t::stop: {
+        command.stopped->set_value(stopMission());
+        break;
+      }
+    }
+  }
+}
+//}
+
+/* spliceWaypoints //{ */
+void Vehicle::spliceWaypoints(const std::vector<local_waypoint_t> &route) {
+
+  // the route is the complete remaining path, compare it with the unreached part of the uploaded window followed by the buffer
+  const size_t window_size    = mission_window_.size();
+  const size_t remaining_size = window_size + waypoint_buffer_.size();
+
+  size_t common = 0;
+  while (common < route.size() && common < remaining_size) {
+    const local_waypoint_t &w  = common < window_size ? mission_window_[common] : waypoint_buffer_[common - window_size];
+    const local_waypoint_t &r  = route[common];
+    const double            dx = w.x - r.x;
+    const double            dy = w.y - r.y;
+    const double            dz = w.z - r.z;
+    if (dx * dx + dy * dy + dz * dz > stream_position_tolerance_ * stream_position_tolerance_ ||
+        std::abs(std::remainder(w.yaw - r.yaw, 2 * M_PI)) > stream_yaw_tolerance_) {
+      break;
+    }
+    common++;
+  }
+
+  if (common == route.size() && common == remaining_size) {
+    return;
+  }
+
+  // the stream is not reserved in advance, the part of the route which does not fit into the buffer is dropped
+  const size_t kept_buffered = common >= window_size ? common - window_size : 0;
+  releaseBuffer(waypoint_buffer_.size() - kept_buffered);
+  waypoint_buffer_.truncate(kept_buffered);
+  const size_t wanted   = route.size() - common;
+  const size_t reserved = reserveBuffer(wanted, true);
+  waypoint_buffer_.append(route.begin() + common, route.begin() + common + reserved);
+  recordBufferSize();
+  if (recorder_ != nullptr) {
+    recorder_->record(flight_record_t::route_spliced, system_id_, int32_t(reserved), {double(common)});
+  }
+  if (reserved < wanted) {
+    buffer_rejections_ += wanted - reserved;
+    RCLCPP_WARN_THROTTLE(node_.get_logger(), *node_.get_clock(), 1000, "[%s]: Waypoint stream: buffer full, dropped the last %ld waypoints", name_.c_str(),
+                         wanted - reserved);
+  }
+
+  if (common < window_size) {
+    // the uploaded window diverges, replace its tail and upload again without pausing the vehicle
+    mission_window_.erase(mission_window_.begin() + common, mission_window_.end());
+    mission_window_items_.erase(mission_window_items_.begin() + common, mission_window_items_.end());
+  }
+
+  if (mission_window_.empty() && waypoint_buffer_.empty()) {
+    // nothing is left to fly, e.g. pending service requests hold all of the buffer, the vehicle must not keep flying the replaced window
+    stopMission();
+    RCLCPP_WARN(node_.get_logger(), "[%s]: Waypoint stream: no waypoint left after replacing %ld waypoints, mission stopped", name_.c_str(),
+                remaining_size - common);
+    return;
+  }
+
+  if (common < window_size && motion_started_ && !mission_finished_) {
+    fillMissionWindow();
+    start_mission_ = true;
+  }
+  // otherwise only the part which has not been uploaded yet changed, the mission window picks it up with the next refill
+  motion_started_ = true;
+
+  RCLCPP_INFO(node_.get_logger(), "[%s]: Waypoint stream: kept %ld, replaced %ld waypoints", name_.c_str(), common, route.size() - common);
+}
+//}
+
+/* stopMission //{ */
+std::future<CommandChannel::result_t> Vehicle::stopMission() {
+
+  // waypoints left over after a disarm would stay in front of the next request
+  releaseBuffer(waypoint_buffer_.size());
+  waypoint_buffer_.clear();
 
   if (!motion_started_) {
-    return true;
+    std::promise<CommandWorker::result_t> idle;
+    idle.set_value({true, "No mission in progress"});
+    return idle.get_future();
   }
 
   motion_started_   = false;
   start_mission_    = false;
   mission_finished_ = true;
 
-  auto result = mission_->pause_mission();
   mission_plan_.mission_items.clear();
-  waypoint_buffer_.clear();
+  mission_window_.clear();
+  mission_window_items_.clear();
 
-  if (result != mavsdk::Mission::Result::Success || mission_plan_.mission_items.size() > 0) {
-    RCLCPP_ERROR(this->get_logger(), "[%s]: Previous mission cannot be stopped", this->get_name());
-    return false;
+  if (commands_ == nullptr) {
+    std::promise<CommandWorker::result_t> idle;
+    idle.set_value({true, "Vehicle never connected, no mission uploaded"});
+    return idle.get_future();
   }
-  RCLCPP_INFO(this->get_logger(), "[%s]: Previous mission stopped", this->get_name());
-  return true;
+
+  if (offboard_control_) {
+    // the offboard setpoint stays where it is, the vehicle holds position without leaving offboard mode
+    std::promise<CommandWorker::result_t> holding;
+    holding.set_value({true, "Holding position"});
+    return holding.get_future();
+  }
+
+  // queued behind any upload requested earlier, so the vehicle ends up paused
+  return commands_->pauseMission();
 }
 //}
 
 /* addToMission //{ */
-void ControlInterface::addToMission(local_waypoint_t w) {
+// converts a waypoint entering the mission window, the item is kept until the waypoint leaves the window
+// next is the waypoint after w, null if w is the last one known so far
+void Vehicle::addToMission(const local_waypoint_t &previous, const local_waypoint_t &w, const local_waypoint_t *next) {
+  const segment_plan_t         segment = planSegment(previous, w, next, segment_limits_);
   mavsdk::Mission::MissionItem item;
   gps_waypoint_t               global = localToGlobal(coord_transform_, w);
   item.latitude_deg                   = global.latitude;
   item.longitude_deg                  = global.longitude;
   item.relative_altitude_m            = global.altitude;
   item.yaw_deg                        = -radToDeg(global.yaw + yaw_offset_correction_);
-  item.speed_m_s                      = target_velocity_;  // NAN = use default values. This does NOT limit vehicle max speed
-  item.is_fly_through                 = true;
-  item.gimbal_pitch_deg               = 0.0f;
-  item.gimbal_yaw_deg                 = 0.0f;
+  item.speed_m_s                      = segment.speed;  // NAN = use default values. This does NOT limit vehicle max speed
+  item.is_fly_through                 = segment.fly_through && waypoint_loiter_time_ <= 0.0;
+  item.gimbal_pitch_deg               = NAN;  // no gimbal items, see mavlinkItemCount()
+  item.gimbal_yaw_deg                 = NAN;
   item.camera_action                  = mavsdk::Mission::MissionItem::CameraAction::None;
   item.loiter_time_s                  = waypoint_loiter_time_;
   item.camera_photo_interval_s        = 0.0f;
-  item.acceptance_radius_m            = waypoint_acceptance_radius_;
-  mission_plan_.mission_items.push_back(item);
+  item.acceptance_radius_m            = item.is_fly_through ? segment.acceptance_radius : waypoint_acceptance_radius_;
+  mission_window_items_.push_back({item, missionItemHash(item), previous});
+
+  RCLCPP_DEBUG(node_.get_logger(), "[%s]: Added waypoint LOCAL: [%.2f, %.2f, %.2f, %.2f], speed %.2f m/s, acceptance %.2f m%s", name_.c_str(), w.x, w.y,
+               w.z, w.yaw, item.speed_m_s, item.acceptance_radius_m, item.is_fly_through ? ", fly through" : "");
+}
+//}
+
+/* fillMissionWindow //{ */
+void Vehicle::fillMissionWindow() {
+  // the waypoint after the last one of the window may have been added or replaced since it was planned
+  if (!mission_window_.empty()) {
+    const local_waypoint_t previous = mission_window_items_.back().previous;
+    mission_window_items_.pop_back();
+    addToMission(previous, mission_window_.back(), waypoint_buffer_.empty() ? nullptr : &waypoint_buffer_.front());
+  }
+
+  // the unreached part of the current window stays at the front, so the vehicle keeps flying towards its current target
+  while (waypoint_buffer_.size() > 0 && mission_window_.size() < static_cast<size_t>(mission_window_size_)) {
+    // without any waypoint behind, the first one is planned as if the vehicle came straight towards it
+    const local_waypoint_t previous = !mission_window_.empty() ? mission_window_.back() : last_window_waypoint_.value_or(waypoint_buffer_.front());
+    mission_window_.push_back(waypoint_buffer_.front());
+    addToMission(previous, waypoint_buffer_.front(), waypoint_buffer_.size() > 1 ? &waypoint_buffer_[1] : nullptr);
+    waypoint_buffer_.pop_front();
+    releaseBuffer(1);
+  }
+
+  mission_plan_.mission_items.clear();
+  for (const auto &p : mission_window_items_) {
+    mission_plan_.mission_items.push_back(p.item);
+  }
+
+  if (mission_window_.empty()) {
+    return;
+  }
+  desired_pose_.store(mission_window_.front());
+}
+//}
+
+/* updateMissionWindow //{ */
+void Vehicle::updateMissionWindow() {
+  if (mission_finished_) {
+    if (!mission_window_.empty()) {
+      last_window_waypoint_ = mission_window_.back();
+    }
+    mission_window_.clear();
+    mission_window_items_.clear();
+    return;
+  }
+
+  bool progressed = false;
+  while (mission_window_.size() > 0 && mission_window_offset_ <= mission_seq_reached_) {
+    last_window_waypoint_ = mission_window_.front();
+    mission_window_.pop_front();
+    mission_window_items_.pop_front();
+    mission_window_offset_++;
+    progressed = true;
+  }
+
+  if (progressed && mission_window_.size() > 0) {
+    desired_pose_.store(mission_window_.front());
+  }
+}
+//}
 
-  RCLCPP_INFO(this->get_logger(), "[%s]: Added waypoint LOCAL: [%.2f, %.2f, %.2f, %.2f]", this->get_name(), w.x, w.y, w.z, w.yaw);
+/* missionWindowNeedsRefill //{ */
+bool Vehicle::missionWindowNeedsRefill() {
+  return mission_window_.size() <= static_cast<size_t>(mission_refill_threshold_);
 }
 //}
 
 /* publishStaticTF //{ */
-void ControlInterface::publishStaticTF() {
+void Vehicle::publishStaticTF() {
 
   geometry_msgs::msg::TransformStamped tf_stamped;
-  tf2::Quaternion                      q;
-  q.setRPY(-M_PI, 0, 0);
   tf_stamped.header.frame_id         = ned_fcu_frame_;
   tf_stamped.child_frame_id          = fcu_frame_;
   tf_stamped.transform.translation.x = 0.0;
   tf_stamped.transform.translation.y = 0.0;
   tf_stamped.transform.translation.z = 0.0;
-  tf_stamped.transform.rotation.x    = q.getX();
-  tf_stamped.transform.rotation.y    = q.getY();
-  tf_stamped.transform.rotation.z    = q.getZ();
-  tf_stamped.transform.rotation.w    = q.getW();
+  tf_stamped.transform.rotation.x    = fcu_in_ned_fcu_.x();
+  tf_stamped.transform.rotation.y    = fcu_in_ned_fcu_.y();
+  tf_stamped.transform.rotation.z    = fcu_in_ned_fcu_.z();
+  tf_stamped.transform.rotation.w    = fcu_in_ned_fcu_.w();
   static_tf_broadcaster_->sendTransform(tf_stamped);
 
-  q.setRPY(M_PI, 0, M_PI / 2);
-  q                                  = q.inverse();
   tf_stamped.header.frame_id         = world_frame_;
   tf_stamped.child_frame_id          = ned_origin_frame_;
   tf_stamped.transform.translation.x = 0.0;
   tf_stamped.transform.translation.y = 0.0;
   tf_stamped.transform.translation.z = 0.0;
-  tf_stamped.transform.rotation.x    = q.getX();
-  tf_stamped.transform.rotation.y    = q.getY();
-  tf_stamped.transform.rotation.z    = q.getZ();
-  tf_stamped.transform.rotation.w    = q.getW();
+  tf_stamped.transform.rotation.x    = ned_origin_in_world_.x();
+  tf_stamped.transform.rotation.y    = ned_origin_in_world_.y();
+  tf_stamped.transform.rotation.z    = ned_origin_in_world_.z();
+  tf_stamped.transform.rotation.w    = ned_origin_in_world_.w();
   static_tf_broadcaster_->sendTransform(tf_stamped);
 }
 //}
 
 /* publishTF //{ */
-void ControlInterface::publishTF() {
-  if (tf_broadcaster_ == nullptr) {
-    tf_broadcaster_ = std::make_shared<tf2_ros::TransformBroadcaster>(this->shared_from_this());
-  }
-  geometry_msgs::msg::TransformStamped tf1;
-  tf1.header.stamp            = this->get_clock()->now();
-  tf1.header.frame_id         = ned_origin_frame_;
-  tf1.child_frame_id          = ned_fcu_frame_;
-  tf1.transform.translation.x = pos_[0];
-  tf1.transform.translation.y = pos_[1];
-  tf1.transform.translation.z = pos_[2];
-  tf1.transform.rotation.w    = ori_[0];
-  tf1.transform.rotation.x    = ori_[1];
-  tf1.transform.rotation.y    = ori_[2];
-  tf1.transform.rotation.z    = ori_[3];
-  tf_broadcaster_->sendTransform(tf1);
+void Vehicle::publishTF(const vehicle_odometry_t &odom, const rclcpp::Time &stamp) {
+  auto &tf1                   = tf_msg_.transforms[0];
+  tf1.header.stamp            = stamp;
+  tf1.transform.translation.x = odom.pos[0];
+  tf1.transform.translation.y = odom.pos[1];
+  tf1.transform.translation.z = odom.pos[2];
+  tf1.transform.rotation.w    = odom.ori[0];
+  tf1.transform.rotation.x    = odom.ori[1];
+  tf1.transform.rotation.y    = odom.ori[2];
+  tf1.transform.rotation.z    = odom.ori[3];
+  publishPreallocated(*tf_publisher_, tf_msg_);
 }
 //}
 
 /* publishLocalOdom //{ */
-void ControlInterface::publishLocalOdom() {
-  nav_msgs::msg::Odometry msg;
-  msg.header.stamp            = this->get_clock()->now();
-  msg.header.frame_id         = world_frame_;
-  msg.child_frame_id          = fcu_frame_;
-  auto tf                     = transformBetween(fcu_frame_, world_frame_);
-  msg.pose.pose.position.x    = tf.pose.position.x;
-  msg.pose.pose.position.y    = tf.pose.position.y;
-  msg.pose.pose.position.z    = tf.pose.position.z;
-  msg.pose.pose.orientation.w = tf.pose.orientation.w;
-  msg.pose.pose.orientation.x = tf.pose.orientation.x;
-  msg.pose.pose.orientation.y = tf.pose.orientation.y;
-  msg.pose.pose.orientation.z = tf.pose.orientation.z;
-  local_odom_publisher_->publish(msg);
+void Vehicle::publishLocalOdom(const vehicle_odometry_t &odom, const rclcpp::Time &stamp) {
+  // world <- ned_origin <- ned_fcu <- fcu, the outer two are the static transforms
+  const Eigen::Vector3d    position = ned_origin_in_world_ * Eigen::Vector3d(odom.pos[0], odom.pos[1], odom.pos[2]);
+  const Eigen::Quaterniond orientation =
+      ned_origin_in_world_ * Eigen::Quaterniond(odom.ori[0], odom.ori[1], odom.ori[2], odom.ori[3]) * fcu_in_ned_fcu_;
+
+  if (verify_local_odom_with_tf_) {
+    verifyLocalOdom(position, orientation, stamp);
+  }
+
+  auto &msg                   = local_odom_msg_;
+  msg.header.stamp            = stamp;
+  msg.pose.pose.position.x    = position.x();
+  msg.pose.pose.position.y    = position.y();
+  msg.pose.pose.position.z    = position.z();
+  msg.pose.pose.orientation.w = orientation.w();
+  msg.pose.pose.orientation.x = orientation.x();
+  msg.pose.pose.orientation.y = orientation.y();
+  msg.pose.pose.orientation.z = orientation.z();
+  publishPreallocated(*local_odom_publisher_, msg);
+}
+//}
+
+/* verifyLocalOdom //{ */
+void Vehicle::verifyLocalOdom(const Eigen::Vector3d &position, const Eigen::Quaterniond &orientation, const rclcpp::Time &stamp) {
+  // the tf2 buffer lags behind by at least one message, compare it with the pose published for the same stamp
+  geometry_msgs::msg::PoseStamped tf_pose;
+  if (transformBetween(fcu_frame_, world_frame_, tf_pose) && rclcpp::Time(tf_pose.header.stamp).nanoseconds() == last_local_odom_stamp_.nanoseconds()) {
+    const Eigen::Vector3d    tf_position(tf_pose.pose.position.x, tf_pose.pose.position.y, tf_pose.pose.position.z);
+    const Eigen::Quaterniond tf_orientation(tf_pose.pose.orientation.w, tf_pose.pose.orientation.x, tf_pose.pose.orientation.y, tf_pose.pose.orientation.z);
+    const double             position_error    = (tf_position - last_local_odom_position_).norm();
+    const double             orientation_error = tf_orientation.angularDistance(last_local_odom_orientation_);
+    if (position_error > 0.01 || orientation_error > 0.01) {
+      RCLCPP_WARN_THROTTLE(node_.get_logger(), *node_.get_clock(), 1000, "[%s]: Local odometry differs from TF by %.3f m, %.3f rad", name_.c_str(),
+                           position_error, orientation_error);
+    }
+  }
+
+  last_local_odom_stamp_       = stamp;
+  last_local_odom_position_    = position;
+  last_local_odom_orientation_ = orientation;
 }
 //}
 
 /* publishDesiredPose //{ */
-void ControlInterface::publishDesiredPose() {
-  if (desired_pose_.z() < 0.5) {
+void Vehicle::publishDesiredPose(const rclcpp::Time &stamp) {
+  auto desired_pose = desired_pose_.load();
+  if (desired_pose.z < 0.5) {
     return;
   }
-  geometry_msgs::msg::PoseStamped msg;
-  msg.header.stamp     = this->get_clock()->now();
-  msg.header.frame_id  = world_frame_;
-  msg.pose.position.x  = desired_pose_.x();
-  msg.pose.position.y  = desired_pose_.y();
-  msg.pose.position.z  = desired_pose_.z();
+  auto &msg            = desired_pose_msg_;
+  msg.header.stamp     = stamp;
+  msg.pose.position.x  = desired_pose.x;
+  msg.pose.position.y  = desired_pose.y;
+  msg.pose.position.z  = desired_pose.z;
   Eigen::Quaterniond q = Eigen::AngleAxisd(0, Eigen::Vector3d::UnitX()) * Eigen::AngleAxisd(0, Eigen::Vector3d::UnitY()) *
-                         Eigen::AngleAxisd(desired_pose_.w(), Eigen::Vector3d::UnitZ());
+                         Eigen::AngleAxisd(desired_pose.yaw, Eigen::Vector3d::UnitZ());
   msg.pose.orientation.w = q.w();
   msg.pose.orientation.x = q.x();
   msg.pose.orientation.y = q.y();
   msg.pose.orientation.z = q.z();
-  desired_pose_publisher_->publish(msg);
+  publishPreallocated(*desired_pose_publisher_, msg);
+}
+//}
+
+/* publishPreallocated //{ */
+// publishes a preinitialized message, it is copied only into a loaned message when the middleware supports loaning
+// with intra-process communication the copy made by rclcpp is handed to the subscribers in the container without serialization
+template <class T>
+void Vehicle::publishPreallocated(rclcpp::Publisher<T> &publisher, const T &msg) {
+  if (publisher.can_loan_messages()) {
+    auto loaned = publisher.borrow_loaned_message();
+    loaned.get() = msg;
+    publisher.publish(std::move(loaned));
+  } else {
+    publisher.publish(msg);
+  }
+}
+//}
+
+/* publishOffboardSetpoint //{ */
+void Vehicle::publishOffboardSetpoint() {
+  const uint64_t timestamp = px4_timestamp_;
+
+  px4_msgs::msg::OffboardControlMode mode;
+  mode.timestamp    = timestamp;
+  mode.position     = true;
+  mode.velocity     = false;
+  mode.acceleration = false;
+  mode.attitude     = false;
+  mode.body_rate    = false;
+  offboard_control_mode_publisher_->publish(mode);
+
+  px4_msgs::msg::TrajectorySetpoint setpoint;
+  setpoint.timestamp = timestamp;
+  setpoint.x         = offboard_position_.x();
+  setpoint.y         = offboard_position_.y();
+  setpoint.z         = offboard_position_.z();
+  setpoint.yaw       = offboard_yaw_;
+  setpoint.yawspeed  = NAN;
+  setpoint.vx        = NAN;
+  setpoint.vy        = NAN;
+  setpoint.vz        = NAN;
+  setpoint.acceleration.fill(NAN);
+  setpoint.jerk.fill(NAN);
+  setpoint.thrust.fill(NAN);
+  trajectory_setpoint_publisher_->publish(setpoint);
+
+  offboard_setpoints_sent_++;
+}
+//}
+
+/* requestOffboardMode //{ */
+void Vehicle::requestOffboardMode() {
+  px4_msgs::msg::VehicleCommand msg;
+  msg.timestamp        = px4_timestamp_;
+  msg.param1           = 1;  // MAV_MODE_FLAG_CUSTOM_MODE_ENABLED
+  msg.param2           = 6;  // PX4_CUSTOM_MAIN_MODE_OFFBOARD
+  msg.command          = px4_msgs::msg::VehicleCommand::VEHICLE_CMD_DO_SET_MODE;
+  msg.target_system    = system_id_;
+  msg.target_component = 1;
+  msg.source_system    = 1;
+  msg.source_component = 1;
+  msg.from_external    = true;
+  vehicle_command_publisher_->publish(msg);
+  RCLCPP_INFO(node_.get_logger(), "[%s]: Requesting offboard mode", name_.c_str());
 }
 //}
 
 /* publishDebugMarkers //{ */
-void ControlInterface::publishDebugMarkers() {
+void Vehicle::publishDebugMarkers() {
   geometry_msgs::msg::PoseArray msg;
-  msg.header.stamp    = this->get_clock()->now();
+  msg.header.stamp    = node_.get_clock()->now();
   msg.header.frame_id = world_frame_;
+  msg.poses.reserve(waypoint_buffer_.size());
   for (auto &w : waypoint_buffer_) {
     geometry_msgs::msg::Pose p;
     p.position.x = w.x;
@@ -1271,10 +2786,10 @@ void ControlInterface::publishDebugMarkers() {
 //}
 
 /* transformBetween //{ */
-geometry_msgs::msg::PoseStamped ControlInterface::transformBetween(std::string frame_from, std::string frame_to) {
-  geometry_msgs::msg::PoseStamped pose_out;
+bool Vehicle::transformBetween(const std::string &frame_from, const std::string &frame_to, geometry_msgs::msg::PoseStamped &pose_out) {
   try {
     auto transform_stamped      = tf_buffer_->lookupTransform(frame_to, frame_from, rclcpp::Time(0));
+    pose_out.header             = transform_stamped.header;
     pose_out.pose.position.x    = transform_stamped.transform.translation.x;
     pose_out.pose.position.y    = transform_stamped.transform.translation.y;
     pose_out.pose.position.z    = transform_stamped.transform.translation.z;
@@ -1284,13 +2799,14 @@ geometry_msgs::msg::PoseStamped ControlInterface::transformBetween(std::string f
     pose_out.pose.orientation.z = transform_stamped.transform.rotation.z;
   }
   catch (...) {
+    return false;
   }
-  return pose_out;
+  return true;
 }
 //}
 
 /* generateColor//{ */
-std_msgs::msg::ColorRGBA ControlInterface::generateColor(const double r, const double g, const double b, const double a) {
+std_msgs::msg::ColorRGBA Vehicle::generateColor(const double r, const double g, const double b, const double a) {
   std_msgs::msg::ColorRGBA c;
   c.r = r;
   c.g = g;
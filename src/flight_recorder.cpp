@@ -0,0 +1,144 @@
+#include <control_interface/flight_recorder.h>
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace control_interface
+{
+
+namespace
+{
+// path with the suffix inserted before the extension of the file name
+std::string withSuffix(const std::string &path, const std::string &suffix) {
+  const size_t slash = path.find_last_of('/');
+  const size_t dot   = path.find_last_of('.');
+  const bool   ext   = dot != std::string::npos && (slash == std::string::npos || dot > slash + 1);
+  return ext ? path.substr(0, dot) + suffix + path.substr(dot) : path + suffix;
+}
+}  // namespace
+
+/* create //{ */
+std::shared_ptr<FlightRecorder> FlightRecorder::create(const std::string &path, const size_t file_records, const size_t queue_records,
+                                                       const std::chrono::milliseconds flush_period, std::string &error) {
+  if (file_records < 2 || queue_records == 0) {
+    error = "flight recorder needs at least 2 records in the file and 1 in the queue";
+    return nullptr;
+  }
+
+  std::shared_ptr<FlightRecorder> recorder(new FlightRecorder());
+
+  // the queue capacity is rounded up to a power of two, positions are mapped to slots with a mask
+  size_t queue_size = 1;
+  while (queue_size < queue_records) {
+    queue_size <<= 1;
+  }
+  recorder->slots_.reset(new slot_t[queue_size]);
+  recorder->mask_ = queue_size - 1;
+  for (size_t i = 0; i < queue_size; i++) {
+    recorder->slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  // a node respawned after a crash must not overwrite the recording of the crash, every start gets a file of its own
+  const std::time_t now = std::time(nullptr);
+  std::tm           utc;
+  gmtime_r(&now, &utc);
+  char stamp[32];
+  std::strftime(stamp, sizeof(stamp), "_%Y%m%dT%H%M%SZ", &utc);
+  for (int attempt = 0; recorder->fd_ < 0; attempt++) {
+    recorder->path_ = withSuffix(path, attempt == 0 ? stamp : stamp + ("_" + std::to_string(attempt)));
+    recorder->fd_   = open(recorder->path_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (recorder->fd_ < 0 && (errno != EEXIST || attempt >= 100)) {
+      error = recorder->path_ + ": " + std::strerror(errno);
+      return nullptr;
+    }
+  }
+  // the whole file is allocated up front, a full disk shows up now and not in flight
+  recorder->file_size_ = sizeof(flight_recorder_header_t) + file_records * sizeof(flight_record_t);
+  if (posix_fallocate(recorder->fd_, 0, recorder->file_size_) != 0) {
+    error = recorder->path_ + ": cannot allocate " + std::to_string(recorder->file_size_) + " bytes";
+    unlink(recorder->path_.c_str());
+    return nullptr;
+  }
+  void *mapped = mmap(nullptr, recorder->file_size_, PROT_READ | PROT_WRITE, MAP_SHARED, recorder->fd_, 0);
+  if (mapped == MAP_FAILED) {
+    error = recorder->path_ + ": " + std::strerror(errno);
+    unlink(recorder->path_.c_str());
+    return nullptr;
+  }
+  recorder->header_  = static_cast<flight_recorder_header_t *>(mapped);
+  recorder->records_ = reinterpret_cast<flight_record_t *>(static_cast<char *>(mapped) + sizeof(flight_recorder_header_t));
+
+  flight_recorder_header_t &header = *recorder->header_;
+  std::memcpy(header.magic, flight_recorder_header_t::magic_value, sizeof(header.magic));
+  header.version       = flight_recorder_header_t::version_value;
+  header.record_size   = sizeof(flight_record_t);
+  header.capacity      = file_records;
+  header.steady_origin = std::chrono::steady_clock::now().time_since_epoch().count();
+  header.system_origin = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  header.written       = 0;
+  header.dropped       = 0;
+
+  recorder->flush_period_ = flush_period;
+  recorder->thread_       = std::thread(&FlightRecorder::run, recorder.get());
+  return recorder;
+}
+//}
+
+/* destructor //{ */
+FlightRecorder::~FlightRecorder() {
+  if (thread_.joinable()) {
+    {
+      std::scoped_lock lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+  }
+  if (header_ != nullptr) {
+    flush();
+    msync(header_, file_size_, MS_SYNC);
+    munmap(header_, file_size_);
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+//}
+
+/* run //{ */
+// the producers never signal the writer, it wakes up once per flush period and takes whatever has been queued
+void FlightRecorder::run() {
+  std::unique_lock lock(mutex_);
+  while (!stop_) {
+    cv_.wait_for(lock, flush_period_);
+    flush();
+  }
+}
+//}
+
+/* flush //{ */
+// The count is published after every record, so a crash can only tear the record at written % capacity. Before the file wraps around that
+// slot is past the end of the recording, afterwards it holds the oldest record, which the decoder therefore skips.
+void FlightRecorder::flush() {
+  uint64_t written = header_->written;
+  while (true) {
+    slot_t &slot = slots_[dequeue_ & mask_];
+    if (slot.sequence.load(std::memory_order_acquire) != dequeue_ + 1) {
+      break;
+    }
+    records_[written % header_->capacity] = slot.record;
+    written++;
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->written = written;
+    slot.sequence.store(dequeue_ + mask_ + 1, std::memory_order_release);
+    dequeue_++;
+  }
+  header_->dropped = dropped_.load(std::memory_order_relaxed);
+}
+//}
+
+}  // namespace control_interface
@@ -0,0 +1,73 @@
+#include <control_interface/flight_recorder.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+// Prints a flight recorder file as CSV, one record per line in the order they were recorded:
+//   flight_recorder_decode control_interface.frec > flight.csv
+// time is in seconds since the recording started, unix_time in seconds since the epoch.
+
+using control_interface::flight_record_t;
+using control_interface::flight_recorder_header_t;
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    std::fprintf(stderr, "usage: %s <file>\n", argv[0]);
+    return 1;
+  }
+
+  std::ifstream file(argv[1], std::ios::binary);
+  if (!file) {
+    std::fprintf(stderr, "%s: cannot open\n", argv[1]);
+    return 1;
+  }
+
+  flight_recorder_header_t header;
+  if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      std::memcmp(header.magic, flight_recorder_header_t::magic_value, sizeof(header.magic)) != 0) {
+    std::fprintf(stderr, "%s: not a flight recorder file\n", argv[1]);
+    return 1;
+  }
+  if (header.version != flight_recorder_header_t::version_value || header.record_size != sizeof(flight_record_t)) {
+    std::fprintf(stderr, "%s: unsupported version %u, record size %u\n", argv[1], header.version, header.record_size);
+    return 1;
+  }
+
+  if (header.capacity < 2) {
+    std::fprintf(stderr, "%s: invalid capacity %" PRIu64 "\n", argv[1], header.capacity);
+    return 1;
+  }
+
+  std::vector<flight_record_t> records(header.capacity);
+  if (!file.read(reinterpret_cast<char *>(records.data()), records.size() * sizeof(flight_record_t))) {
+    std::fprintf(stderr, "%s: truncated\n", argv[1]);
+    return 1;
+  }
+
+  // once the file has wrapped around, the oldest record follows the newest one, the slot between them may be torn and is skipped
+  const uint64_t count = std::min<uint64_t>(header.written, header.capacity - 1);
+  const uint64_t first = (header.written - count) % header.capacity;
+  std::fprintf(stderr, "%s: %" PRIu64 " records written, %" PRIu64 " kept, %" PRIu64 " dropped\n", argv[1], header.written, count, header.dropped);
+
+  std::printf("time,unix_time,vehicle,type,code,v0,v1,v2,v3,v4,v5\n");
+  for (uint64_t i = 0; i < count; i++) {
+    const flight_record_t &r    = records[(first + i) % header.capacity];
+    const int64_t          time = r.stamp - header.steady_origin;
+    const char *type = r.type < flight_record_t::type_count ? flight_record_t::type_names[r.type] : "unknown";
+    std::printf("%.6f,%.6f,%u,%s,", time * 1e-9, (header.system_origin + time) * 1e-9, r.vehicle, type);
+    if (r.type == flight_record_t::command_result && r.code >= 0 && r.code < flight_record_t::command_count) {
+      std::printf("%s", flight_record_t::command_names[r.code]);
+    } else {
+      std::printf("%d", r.code);
+    }
+    for (const double v : r.values) {
+      std::printf(",%.9g", v);
+    }
+    std::printf("\n");
+  }
+  return 0;
+}
@@ -0,0 +1,117 @@
+#include <control_interface/geodetic_transform.h>
+#include <gtest/gtest.h>
+#include <mavsdk/geometry.h>
+#include <random>
+#include <vector>
+
+namespace control_interface
+{
+
+/* origin //{ */
+// rounding used to push the cosine of the angular distance above 1 at the origin, and acos() returned NaN
+TEST(GeodeticTransform, OriginIsZero) {
+  std::mt19937                           gen(42);
+  std::uniform_real_distribution<double> latitude(-89.0, 89.0);
+  std::uniform_real_distribution<double> longitude(-180.0, 180.0);
+  for (int i = 0; i < 100000; i++) {
+    const GeodeticTransform transform(latitude(gen), longitude(gen));
+    double                  east, north;
+    transform.localFromGlobal(transform.refLatitude(), transform.refLongitude(), east, north);
+    ASSERT_NEAR(east, 0.0, 1e-9) << "origin " << transform.refLatitude() << ", " << transform.refLongitude();
+    ASSERT_NEAR(north, 0.0, 1e-9) << "origin " << transform.refLatitude() << ", " << transform.refLongitude();
+  }
+}
+//}
+
+/* near origin //{ */
+// points a few millimetres to metres from the origin, in the single point and the batch conversion
+TEST(GeodeticTransform, NearOriginRoundTrip) {
+  std::mt19937                           gen(7);
+  std::uniform_real_distribution<double> latitude(-85.0, 85.0);
+  std::uniform_real_distribution<double> longitude(-180.0, 180.0);
+  std::uniform_real_distribution<double> offset(-5.0, 5.0);  // [m]
+  constexpr size_t                       n = 64;
+  for (int i = 0; i < 1000; i++) {
+    const GeodeticTransform transform(latitude(gen), longitude(gen));
+    double                  east[n], north[n], lat[n], lon[n], east_back[n], north_back[n];
+    for (size_t j = 0; j < n; j++) {
+      const double scale = std::pow(10.0, -double(j % 4));  // down to 5 mm
+      east[j]            = offset(gen) * scale;
+      north[j]           = offset(gen) * scale;
+    }
+    transform.globalFromLocal(east, north, lat, lon, n);
+    transform.localFromGlobal(lat, lon, east_back, north_back, n);
+    for (size_t j = 0; j < n; j++) {
+      ASSERT_NEAR(east_back[j], east[j], 1e-6) << "origin " << transform.refLatitude() << ", " << transform.refLongitude();
+      ASSERT_NEAR(north_back[j], north[j], 1e-6) << "origin " << transform.refLatitude() << ", " << transform.refLongitude();
+
+      double east_single, north_single;
+      transform.localFromGlobal(lat[j], lon[j], east_single, north_single);
+      ASSERT_NEAR(east_single, east_back[j], 1e-9);
+      ASSERT_NEAR(north_single, north_back[j], 1e-9);
+    }
+  }
+}
+//}
+
+/* against MAVSDK //{ */
+// the tolerance documented in geodetic_transform.h, for random origins and points from 1 m to 100 km away, in the single point and the batch
+// conversion; closer points are covered by the tests above, MAVSDK does not clamp the acos() argument there
+TEST(GeodeticTransform, MatchesMavsdk) {
+  using mavsdk::geometry::CoordinateTransformation;
+  constexpr double local_tolerance  = 1e-6;   // [m]
+  constexpr double global_tolerance = 1e-11;  // [deg]
+
+  std::mt19937                           gen(1);
+  std::uniform_real_distribution<double> latitude(-85.0, 85.0);
+  std::uniform_real_distribution<double> longitude(-180.0, 180.0);
+  std::uniform_real_distribution<double> log_distance(0.0, 5.0);  // [log10 m]
+  std::uniform_real_distribution<double> bearing(-M_PI, M_PI);
+  constexpr size_t                       n = 1000;  // not a multiple of the batch block
+  for (int i = 0; i < 100; i++) {
+    CoordinateTransformation::GlobalCoordinate origin;
+    origin.latitude_deg  = latitude(gen);
+    origin.longitude_deg = longitude(gen);
+    const CoordinateTransformation reference(origin);
+    const GeodeticTransform        transform(origin.latitude_deg, origin.longitude_deg);
+
+    std::vector<double> east(n), north(n), lat(n), lon(n), lat_batch(n), lon_batch(n), east_batch(n), north_batch(n);
+    for (size_t j = 0; j < n; j++) {
+      const double distance = std::pow(10.0, log_distance(gen));
+      const double angle    = bearing(gen);
+      east[j]               = distance * std::sin(angle);
+      north[j]              = distance * std::cos(angle);
+      CoordinateTransformation::LocalCoordinate local;
+      local.north_m     = north[j];
+      local.east_m      = east[j];
+      const auto global = reference.global_from_local(local);
+      lat[j]            = global.latitude_deg;
+      lon[j]            = global.longitude_deg;
+    }
+    transform.globalFromLocal(east.data(), north.data(), lat_batch.data(), lon_batch.data(), n);
+    transform.localFromGlobal(lat.data(), lon.data(), east_batch.data(), north_batch.data(), n);
+
+    for (size_t j = 0; j < n; j++) {
+      CoordinateTransformation::GlobalCoordinate global;
+      global.latitude_deg  = lat[j];
+      global.longitude_deg = lon[j];
+      const auto local     = reference.local_from_global(global);
+
+      double east_single, north_single, lat_single, lon_single;
+      transform.localFromGlobal(lat[j], lon[j], east_single, north_single);
+      transform.globalFromLocal(east[j], north[j], lat_single, lon_single);
+
+      ASSERT_NEAR(east_single, local.east_m, local_tolerance) << "origin " << origin.latitude_deg << ", " << origin.longitude_deg;
+      ASSERT_NEAR(north_single, local.north_m, local_tolerance) << "origin " << origin.latitude_deg << ", " << origin.longitude_deg;
+      ASSERT_NEAR(east_batch[j], local.east_m, local_tolerance) << "origin " << origin.latitude_deg << ", " << origin.longitude_deg;
+      ASSERT_NEAR(north_batch[j], local.north_m, local_tolerance) << "origin " << origin.latitude_deg << ", " << origin.longitude_deg;
+      ASSERT_NEAR(lat_single, lat[j], global_tolerance) << "origin " << origin.latitude_deg << ", " << origin.longitude_deg;
+      ASSERT_NEAR(lon_single, lon[j], global_tolerance) << "origin " << origin.latitude_deg << ", " << origin.longitude_deg;
+      ASSERT_NEAR(lat_batch[j], lat[j], global_tolerance) << "origin " << origin.latitude_deg << ", " << origin.longitude_deg;
+      ASSERT_NEAR(lon_batch[j], lon[j], global_tolerance) << "origin " << origin.latitude_deg << ", " << origin.longitude_deg;
+    }
+  }
+}
+//}
+
+}  // namespace control_interface
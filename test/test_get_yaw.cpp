@@ -0,0 +1,96 @@
+#include <control_interface/control_interface.h>
+#include <gtest/gtest.h>
+
+// getYaw() against the implementation it replaced, the third angle of Eigen's eulerAngles(0, 1, 2)
+
+namespace control_interface
+{
+
+namespace
+{
+
+double eulerAnglesYaw(const Eigen::Quaterniond &q) {
+  return q.toRotationMatrix().eulerAngles(0, 1, 2)[2];
+}
+
+// PX4 and ROS attitudes are ZYX: yaw, then pitch, then roll
+Eigen::Quaterniond fromYawPitchRoll(const double yaw, const double pitch, const double roll) {
+  return Eigen::AngleAxisd(yaw, Eigen::Vector3d::UnitZ()) * Eigen::AngleAxisd(pitch, Eigen::Vector3d::UnitY()) *
+         Eigen::AngleAxisd(roll, Eigen::Vector3d::UnitX());
+}
+
+double angleDiff(const double a, const double b) {
+  return std::abs(std::remainder(a - b, 2 * M_PI));
+}
+
+}  // namespace
+
+/* level //{ */
+// a level vehicle is the only case where the two decompositions agree
+TEST(GetYaw, LevelMatchesEulerAngles) {
+  for (double yaw = -3.14; yaw <= 3.14; yaw += 0.01) {
+    const Eigen::Quaterniond q = fromYawPitchRoll(yaw, 0.0, 0.0);
+    EXPECT_NEAR(angleDiff(getYaw(q), yaw), 0.0, 1e-12) << "yaw " << yaw;
+    EXPECT_NEAR(angleDiff(getYaw(q), eulerAnglesYaw(q)), 0.0, 1e-12) << "yaw " << yaw;
+  }
+}
+//}
+
+/* tilted //{ */
+// getYaw() is the ZYX heading for any attitude. eulerAngles(0, 1, 2) is an XYZ decomposition with its first angle kept in [0, pi], so for
+// a tilted vehicle its third angle is off by pi whenever the first one would be negative, and otherwise by up to about tilt^2, because
+// the XYZ yaw is applied after the roll and the pitch instead of before them.
+TEST(GetYaw, TiltedDiffersFromEulerAngles) {
+  for (const double tilt : {0.05, 0.1, 0.3}) {
+    size_t flipped = 0;
+    size_t samples = 0;
+    for (double yaw = -3.14; yaw <= 3.14; yaw += 0.01) {
+      for (const double pitch : {-tilt, 0.0, tilt}) {
+        for (const double roll : {-tilt, 0.0, tilt}) {
+          const Eigen::Quaterniond q = fromYawPitchRoll(yaw, pitch, roll);
+          EXPECT_NEAR(angleDiff(getYaw(q), yaw), 0.0, 1e-12) << "yaw " << yaw << ", pitch " << pitch << ", roll " << roll;
+
+          const double diff = angleDiff(getYaw(q), eulerAnglesYaw(q));
+          if (diff > M_PI / 2) {
+            flipped++;
+          }
+          EXPECT_LE(std::min(diff, M_PI - diff), 1.1 * tilt * tilt) << "yaw " << yaw << ", pitch " << pitch << ", roll " << roll;
+          samples++;
+        }
+      }
+    }
+    EXPECT_GT(flipped, 0u) << "tilt " << tilt;
+    EXPECT_LT(flipped, samples) << "tilt " << tilt;
+  }
+}
+//}
+
+/* overloads //{ */
+// the PX4 float quaternion, the ROS message and the path batch give the same yaw as the Eigen overload
+TEST(GetYaw, OverloadsAgree) {
+  nav_msgs::msg::Path path;
+  std::vector<double> expected;
+  for (double yaw = -3.0; yaw <= 3.0; yaw += 0.5) {
+    const Eigen::Quaterniond q     = fromYawPitchRoll(yaw, 0.2, -0.1);
+    const float              qf[4] = {float(q.w()), float(q.x()), float(q.y()), float(q.z())};
+    EXPECT_NEAR(getYaw(qf), getYaw(q), 1e-6);
+
+    geometry_msgs::msg::PoseStamped pose;
+    pose.pose.orientation.w = q.w();
+    pose.pose.orientation.x = q.x();
+    pose.pose.orientation.y = q.y();
+    pose.pose.orientation.z = q.z();
+    EXPECT_DOUBLE_EQ(getYaw(pose.pose.orientation), getYaw(q));
+    path.poses.push_back(pose);
+    expected.push_back(getYaw(q));
+  }
+
+  const std::vector<double> yaws = getYaw(path);
+  ASSERT_EQ(yaws.size(), expected.size());
+  for (size_t i = 0; i < yaws.size(); i++) {
+    EXPECT_DOUBLE_EQ(yaws[i], expected[i]);
+  }
+}
+//}
+
+}  // namespace control_interface
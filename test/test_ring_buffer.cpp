@@ -0,0 +1,50 @@
+#include <control_interface/ring_buffer.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+namespace control_interface
+{
+
+/* random access //{ */
+TEST(RingBuffer, RandomAccessIterator) {
+  static_assert(std::is_same_v<std::iterator_traits<RingBuffer<int>::iterator>::iterator_category, std::random_access_iterator_tag>);
+
+  // the items wrap around the end of the slots, so that the iterators cross it
+  RingBuffer<int>        buffer(8);
+  const std::vector<int> items = {5, 3, 8, 1, 9, 2};
+  for (int i = 0; i < 5; i++) {
+    buffer.push_back(-1);
+    buffer.pop_front();
+  }
+  buffer.append(items.begin(), items.end());
+  const auto begin = buffer.begin();
+  const auto end   = buffer.end();
+
+  EXPECT_EQ(end - begin, 6);
+  EXPECT_EQ(*std::prev(end), 2);
+  EXPECT_EQ(*(2 + begin), 8);
+  EXPECT_EQ(begin[4], 9);
+
+  auto it = end;
+  std::advance(it, -3);
+  EXPECT_EQ(*it, 1);
+  it -= 2;
+  EXPECT_EQ(*it--, 3);
+  EXPECT_EQ(it, begin);
+  it += 6;
+  EXPECT_EQ(it, end);
+  EXPECT_TRUE(begin < end && end > begin && begin <= begin && end >= begin);
+
+  std::sort(buffer.begin(), buffer.end());
+  EXPECT_TRUE(std::is_sorted(buffer.begin(), buffer.end()));
+  EXPECT_EQ(std::vector<int>(buffer.begin(), buffer.end()), (std::vector<int>{1, 2, 3, 5, 8, 9}));
+
+  const RingBuffer<int> &const_buffer = buffer;
+  EXPECT_EQ(*std::lower_bound(const_buffer.begin(), const_buffer.end(), 4), 5);
+  EXPECT_EQ(std::accumulate(const_buffer.begin(), const_buffer.end(), 0), 28);
+}
+//}
+
+}  // namespace control_interface